@@ -1,12 +1,15 @@
 #include "diagnostics.h"
+#include "../../Utils/MapBuffer/map_buffer.h"
 
 namespace diagnostics_space {
 
     void diagnostics_space::Diagnostics::plotMap() {
+        const map_snapshot *snapshot = global_map_buffer.acquire();
+
         for (int i = 0; i < MAP_MAX; i++) {
             uchar* ptr = (uchar *) (map_image->imageData + i * map_image->widthStep);
             for (int j = 0; j < MAP_MAX; j++) {
-                if (global_map[j][MAP_MAX - i - 1] > 0) {
+                if (snapshot->cells[j][MAP_MAX - i - 1] > 0) {
                     ptr[3 * j] = 0;
                     ptr[3 * j + 1] = 0;
                     ptr[3 * j + 2] = 0;
@@ -18,6 +21,8 @@ namespace diagnostics_space {
             }
         }
 
+        global_map_buffer.release(snapshot);
+
         cvShowImage("Diag Map", map_image);
         cvWaitKey(1);
     }
@@ -29,9 +29,7 @@ void *diagnostics_thread(void *arg) {
         //diagnostics_space::Diagnostics::printOdom();
         //pthread_mutex_unlock(&odom_mutex);
 
-        pthread_mutex_lock(&lidar_map_mutex);
         diagnostics_space::Diagnostics::plotMap();
-        pthread_mutex_unlock(&lidar_map_mutex);
 
         //pthread_mutex_lock(&bot_location_mutex);
         //diagnostics_space::Diagnostics::printBotLocation();
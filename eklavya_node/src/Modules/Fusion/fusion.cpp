@@ -1,31 +1,43 @@
 #include "fusion.h"
 
-void Fusion::laneLidar() {
-    pthread_mutex_lock(&lidar_map_mutex);
-    for (int i = 0; i < MAP_MAX; i++) {
-        for (int j = 0; j < MAP_MAX; j++) {
-            my_lidar_map[i][j] = lidar_map[i][j];
-        }
-    }
-    pthread_mutex_unlock(&lidar_map_mutex);
+bool Fusion::laneLidar() {
+    // Both inputs are borrowed read-only for the merge, nothing is copied first
+    const map_snapshot *lidar = lidar_map_buffer.acquire();
+    const map_snapshot *camera = camera_map_buffer.acquire();
 
-    pthread_mutex_lock(&camera_map_mutex);
-    for (int i = 0; i < MAP_MAX; i++) {
-        for (int j = 0; j < MAP_MAX; j++) {
-            my_camera_map[i][j] = camera_map[i][j];
-        }
+    if (lidar->version == lidar_version && camera->version == camera_version) {
+        camera_map_buffer.release(camera);
+        lidar_map_buffer.release(lidar);
+        return false;
     }
-    pthread_mutex_unlock(&camera_map_mutex);
 
-    pthread_mutex_lock(&global_map_mutex);
-    for (int i = 0; i < MAP_MAX; i++) {
-        for (int j = 0; j < MAP_MAX; j++) {
-            if (my_camera_map[i][j] == 255 || my_lidar_map[i][j] == 255) {
-                global_map[i][j] = 255;
-            } else {
-                global_map[i][j] = 0;
-            }
-        }
+    map_snapshot *out = global_map_buffer.beginWrite();
+    if (out == NULL) {
+        ROS_WARN("[FUSION] All map buffers are in use, dropping this map");
+        camera_map_buffer.release(camera);
+        lidar_map_buffer.release(lidar);
+        return false;
     }
-    pthread_mutex_unlock(&global_map_mutex);
+
+    // Written in both layouts so that readers never have to copy. The inputs carry both
+    // layouts too, so each is a straight merge and nothing is transposed here.
+    fusion_layer layers[2];
+    layers[0].cells = &lidar->cells[0][0];
+    layers[0].weight = FUSION_LIDAR_WEIGHT;
+    layers[1].cells = &camera->cells[0][0];
+    layers[1].weight = FUSION_CAMERA_WEIGHT;
+    fuseLayers(layers, 2, &out->cells[0][0], MAP_MAX * MAP_MAX);
+
+    // MapBuffer images are allocated whole, so their rows are contiguous
+    layers[0].cells = lidar->image.ptr(0);
+    layers[1].cells = camera->image.ptr(0);
+    fuseLayers(layers, 2, out->image.ptr(0), MAP_MAX * MAP_MAX);
+
+    lidar_version = lidar->version;
+    camera_version = camera->version;
+    camera_map_buffer.release(camera);
+    lidar_map_buffer.release(lidar);
+
+    global_map_buffer.publish(out);
+    return true;
 }
@@ -1,11 +1,21 @@
 #include "../../eklavya2.h"
+#include "../../Utils/MapBuffer/map_buffer.h"
+#include "fusion_kernel.h"
 
-using namespace std;
+/* Per-layer confidence, see fusion_kernel.h; FUSION_OCCUPIED each keeps the plain OR of both maps */
+#define FUSION_LIDAR_WEIGHT FUSION_OCCUPIED
+#define FUSION_CAMERA_WEIGHT FUSION_OCCUPIED
 
-extern unsigned char my_lidar_map[MAP_MAX][MAP_MAX];
-extern unsigned char my_camera_map[MAP_MAX][MAP_MAX];
+using namespace std;
 
 class Fusion {
 public:
-    void laneLidar();
+    Fusion() : lidar_version(0), camera_version(0) {
+    }
+
+    /// Merges the latest lidar and camera maps, false if neither changed since the last merge
+    bool laneLidar();
+
+private:
+    unsigned int lidar_version, camera_version; // of the maps merged last
 };
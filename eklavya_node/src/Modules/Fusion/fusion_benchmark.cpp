@@ -0,0 +1,123 @@
+/**
+ * Microbenchmark of the fusion kernels on random maps. Needs no ROS master.
+ *
+ * Usage:
+ *   fusion_benchmark [--repeat N] [--layers N] [--density PERCENT] [--seed S]
+ *
+ * Every kernel this CPU runs merges the same MAP_MAX x MAP_MAX layers and is
+ * checked against the byte-at-a-time loop Fusion::laneLidar() used before.
+ * The report gives the mean time of one merge and the memory traffic it
+ * sustains (every layer read once, the output written once).
+ */
+
+#include "fusion_kernel.h"
+#include "../../eklavya2.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/time.h>
+
+#define BENCHMARK_REPEAT 200
+
+/// The branching merge fusion_kernel replaced, for reference; all-255 weights only
+static void fuseLayersBytewise(const fusion_layer *layers, int n_layers, unsigned char *out, int size) {
+    for (int i = 0; i < size; i++) {
+        out[i] = 0;
+        for (int k = 0; k < n_layers; k++) {
+            if (layers[k].cells[i] == 255) {
+                out[i] = 255;
+                break;
+            }
+        }
+    }
+}
+
+static double now() {
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return t.tv_sec + t.tv_usec * 1e-6;
+}
+
+int main(int argc, char **argv) {
+    int repeat = BENCHMARK_REPEAT;
+    int n_layers = 2;
+    int density = 10;
+    unsigned int seed = 1;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--repeat" && i + 1 < argc) {
+            repeat = atoi(argv[++i]);
+        } else if (arg == "--layers" && i + 1 < argc) {
+            n_layers = atoi(argv[++i]);
+        } else if (arg == "--density" && i + 1 < argc) {
+            density = atoi(argv[++i]);
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seed = atoi(argv[++i]);
+        } else {
+            printf("Usage: %s [--repeat N] [--layers N] [--density PERCENT] [--seed S]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (repeat <= 0 || n_layers < 1 || n_layers > FUSION_MAX_LAYERS) {
+        printf("--repeat must be positive and --layers between 1 and %d\n", FUSION_MAX_LAYERS);
+        return 1;
+    }
+
+    const int size = MAP_MAX * MAP_MAX;
+    srand(seed);
+
+    fusion_layer layers[FUSION_MAX_LAYERS];
+    for (int k = 0; k < n_layers; k++) {
+        unsigned char *cells = new unsigned char[size];
+        for (int i = 0; i < size; i++) {
+            // Some values just below 255 so that a kernel testing for any non zero cell is caught
+            int r = rand() % 100;
+            cells[i] = r < density ? 255 : (r < density + 5 ? 254 : 0);
+        }
+        layers[k].cells = cells;
+        layers[k].weight = FUSION_OCCUPIED;
+    }
+
+    unsigned char *expected = new unsigned char[size];
+    unsigned char *out = new unsigned char[size];
+    fuseLayersBytewise(layers, n_layers, expected, size);
+
+    const char *names[] = {"bytewise", "scalar", "sse2", "avx2"};
+    fusion_kernel kernels[] = {&fuseLayersBytewise, &fuseLayersScalar, fusionKernelSSE2(), fusionKernelAVX2()};
+
+    printf("%d layers of %d cells, %d%% occupied, %d runs, fuseLayers() uses %s\n",
+            n_layers, size, density, repeat, fusionKernelName());
+    printf("%-10s %10s %10s %8s\n", "kernel", "ms/merge", "GB/s", "check");
+
+    int failed = 0;
+    for (int m = 0; m < 4; m++) {
+        if (kernels[m] == NULL) {
+            printf("%-10s %10s\n", names[m], "n/a");
+            continue;
+        }
+
+        memset(out, 0x5a, size);
+        kernels[m](layers, n_layers, out, size);
+        bool ok = memcmp(out, expected, size) == 0;
+        failed += !ok;
+
+        double start = now();
+        for (int r = 0; r < repeat; r++) {
+            kernels[m](layers, n_layers, out, size);
+        }
+        double per_merge = (now() - start) / repeat;
+
+        printf("%-10s %10.3f %10.2f %8s\n", names[m], per_merge * 1e3,
+                (double) (n_layers + 1) * size / per_merge / 1e9, ok ? "ok" : "FAILED");
+    }
+
+    for (int k = 0; k < n_layers; k++) {
+        delete [] layers[k].cells;
+    }
+    delete [] expected;
+    delete [] out;
+
+    return failed > 0;
+}
@@ -0,0 +1,127 @@
+#include "fusion_kernel.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define FUSION_SSE2
+#endif
+
+// target("avx2") lets this file build without -mavx2, the kernel is only called on CPUs that have it
+#if defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define FUSION_AVX2
+#endif
+
+void fuseLayersScalar(const fusion_layer *layers, int n_layers, unsigned char *out, int size) {
+    for (int i = 0; i < size; i++) {
+        int sum = 0;
+        for (int k = 0; k < n_layers; k++) {
+            sum += (layers[k].cells[i] == FUSION_OCCUPIED) * layers[k].weight;
+        }
+        out[i] = sum >= FUSION_OCCUPIED ? FUSION_OCCUPIED : 0;
+    }
+}
+
+#ifdef FUSION_SSE2
+
+static void fuseLayersSSE2(const fusion_layer *layers, int n_layers, unsigned char *out, int size) {
+    const __m128i occupied = _mm_set1_epi8((char) FUSION_OCCUPIED);
+    __m128i weights[FUSION_MAX_LAYERS];
+    for (int k = 0; k < n_layers; k++) {
+        weights[k] = _mm_set1_epi8((char) layers[k].weight);
+    }
+
+    int i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i sum = _mm_setzero_si128();
+        for (int k = 0; k < n_layers; k++) {
+            __m128i v = _mm_loadu_si128((const __m128i *) (layers[k].cells + i));
+            sum = _mm_adds_epu8(sum, _mm_and_si128(_mm_cmpeq_epi8(v, occupied), weights[k]));
+        }
+        _mm_storeu_si128((__m128i *) (out + i), _mm_cmpeq_epi8(sum, occupied));
+    }
+
+    if (i < size) {
+        fusion_layer tail[FUSION_MAX_LAYERS];
+        for (int k = 0; k < n_layers; k++) {
+            tail[k].cells = layers[k].cells + i;
+            tail[k].weight = layers[k].weight;
+        }
+        fuseLayersScalar(tail, n_layers, out + i, size - i);
+    }
+}
+#endif
+
+#ifdef FUSION_AVX2
+
+__attribute__((target("avx2")))
+static void fuseLayersAVX2(const fusion_layer *layers, int n_layers, unsigned char *out, int size) {
+    const __m256i occupied = _mm256_set1_epi8((char) FUSION_OCCUPIED);
+    __m256i weights[FUSION_MAX_LAYERS];
+    for (int k = 0; k < n_layers; k++) {
+        weights[k] = _mm256_set1_epi8((char) layers[k].weight);
+    }
+
+    int i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i sum = _mm256_setzero_si256();
+        for (int k = 0; k < n_layers; k++) {
+            __m256i v = _mm256_loadu_si256((const __m256i *) (layers[k].cells + i));
+            sum = _mm256_adds_epu8(sum, _mm256_and_si256(_mm256_cmpeq_epi8(v, occupied), weights[k]));
+        }
+        _mm256_storeu_si256((__m256i *) (out + i), _mm256_cmpeq_epi8(sum, occupied));
+    }
+
+    if (i < size) {
+        fusion_layer tail[FUSION_MAX_LAYERS];
+        for (int k = 0; k < n_layers; k++) {
+            tail[k].cells = layers[k].cells + i;
+            tail[k].weight = layers[k].weight;
+        }
+        fuseLayersScalar(tail, n_layers, out + i, size - i);
+    }
+}
+#endif
+
+fusion_kernel fusionKernelSSE2() {
+#ifdef FUSION_SSE2
+    return &fuseLayersSSE2;
+#else
+    return NULL;
+#endif
+}
+
+fusion_kernel fusionKernelAVX2() {
+#ifdef FUSION_AVX2
+    // The kernel is picked during static initialization, maybe before libgcc has looked at the CPU
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return &fuseLayersAVX2;
+    }
+#endif
+    return NULL;
+}
+
+static fusion_kernel bestKernel(const char **name) {
+    fusion_kernel kernel = fusionKernelAVX2();
+    *name = "avx2";
+    if (kernel == NULL) {
+        kernel = fusionKernelSSE2();
+        *name = "sse2";
+    }
+    if (kernel == NULL) {
+        kernel = &fuseLayersScalar;
+        *name = "scalar";
+    }
+    return kernel;
+}
+
+static const char *best_name = NULL;
+static fusion_kernel best = bestKernel(&best_name);
+
+void fuseLayers(const fusion_layer *layers, int n_layers, unsigned char *out, int size) {
+    best(layers, n_layers, out, size);
+}
+
+const char *fusionKernelName() {
+    return best_name;
+}
@@ -0,0 +1,34 @@
+#ifndef _FUSION_KERNEL_H_
+#define _FUSION_KERNEL_H_
+
+/**
+ * Cell-wise merge of occupancy layers (lidar, lane, ...), vectorized with
+ * AVX2 or SSE2 where the CPU has them and scalar otherwise.
+ *
+ * A layer marks a cell with 255. Each marking layer adds its weight, with
+ * saturation at 255, and the cell comes out 255 once the sum reaches 255,
+ * else 0. A layer of weight 255 decides on its own, so all-255 weights are a
+ * plain OR; lower weights make a layer need the others to agree.
+ */
+#define FUSION_MAX_LAYERS 8
+#define FUSION_OCCUPIED 255
+
+typedef struct fusion_layer {
+    const unsigned char *cells;
+    unsigned char weight; // confidence, FUSION_OCCUPIED for a layer trusted alone
+} fusion_layer;
+
+typedef void (*fusion_kernel)(const fusion_layer *layers, int n_layers, unsigned char *out, int size);
+
+/// Merges size cells of n_layers (at most FUSION_MAX_LAYERS) layers into out, with the fastest kernel this CPU runs
+void fuseLayers(const fusion_layer *layers, int n_layers, unsigned char *out, int size);
+
+/// Name of the kernel fuseLayers() uses: "avx2", "sse2" or "scalar"
+const char *fusionKernelName();
+
+/* The kernels themselves, for the benchmark; NULL where not compiled or not supported by this CPU */
+void fuseLayersScalar(const fusion_layer *layers, int n_layers, unsigned char *out, int size);
+fusion_kernel fusionKernelSSE2();
+fusion_kernel fusionKernelAVX2();
+
+#endif
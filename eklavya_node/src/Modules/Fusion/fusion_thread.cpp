@@ -1,17 +1,26 @@
 #include "fusion.h"
 
-unsigned char my_lidar_map[MAP_MAX][MAP_MAX];
-unsigned char my_camera_map[MAP_MAX][MAP_MAX];
+/**
+ * Fusion runs when the lidar or the lane thread publishes a map, so a new
+ * scan reaches the planner without waiting out a fixed period. The timeout
+ * only bounds how long ros::ok() goes unchecked.
+ */
+#define FUSION_TIMEOUT 0.5 // seconds
+
+MapSignal sensor_maps; // outlives the thread, the sensor threads may still raise it
 
 void *fusion_thread(void *arg) {
-    ros::Rate loop_rate(LOOP_RATE);
-    
+    lidar_map_buffer.attach(&sensor_maps);
+    camera_map_buffer.attach(&sensor_maps);
+    unsigned int seen = 0;
+
     ROS_INFO("Fusion module started");
-    
+
+    Fusion fuse;
     while (ros::ok()) {
-        Fusion fuse;
+        // Maps published before the signal was attached are merged by the first call
         fuse.laneLidar();
-        loop_rate.sleep();
+        sensor_maps.wait(&seen, FUSION_TIMEOUT);
     }
 
     ROS_INFO("Fusion module exiting");
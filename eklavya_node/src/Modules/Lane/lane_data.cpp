@@ -1,11 +1,14 @@
 #include "lane_data.h"
+#include "../../Utils/EgoMotion/ego_motion.h"
+#include "../../Utils/MapBuffer/map_buffer.h"
+#include "../../Utils/RollingGrid/rolling_grid.h"
 #include <cvblob.h>
 #include <math.h>
 
 using namespace cvb;
 
 #define DEBUG 0
-#define EXPANSION 60
+#define EXPANSION 60 // cells lanes are inflated by
 
 sensor_msgs::CvBridge bridge;
 static int iter = 0;
@@ -14,7 +17,11 @@ IplImage *green_img;
 IplImage *filter_img;
 IplImage *warp_img;
 IplImage* img;
-IplConvKernel *ker1;
+IplImage *fov_img; // 255 where the camera sees the ground, in the map frame like warp_img
+IplImage *inflate_dist; // scratch of inflateMap()
+// Lanes are accumulated here, so those that left the camera's view stay on the map
+static RollingGrid lane_grid;
+static EgoMotion lane_motion;
 CvPoint2D32f srcQuad[4], dstQuad[4];
 CvMat* warp_matrix = cvCreateMat(3, 3, CV_32FC1);
 
@@ -76,7 +83,7 @@ void LaneDetection::initializeLaneVariables(IplImage *input_frame) {
     green_img = cvCreateImage(cvGetSize(input_frame), input_frame->depth, 1);
     filter_img = cvCreateImage(cvGetSize(input_frame), input_frame->depth, 1);
     warp_img = cvCreateImage(cvSize(MAP_MAX, MAP_MAX), 8, 1);
-    ker1 = cvCreateStructuringElementEx(3, 3, 1, 1, CV_SHAPE_ELLIPSE);
+    inflate_dist = cvCreateImage(cvSize(MAP_MAX, MAP_MAX), IPL_DEPTH_32F, 1);
     //Destination variables
     int widthInCM = 100, h1 = 220, h2 = 295; //width and height of the lane. width:widthoflane/scale;
     
@@ -99,18 +106,33 @@ void LaneDetection::initializeLaneVariables(IplImage *input_frame) {
     dstQuad[3].y = (float) (999 - h1);
 
     cvGetPerspectiveTransform(dstQuad, srcQuad, warp_matrix);
+
+    // The ground the camera sees: a white frame through the same warp
+    IplImage *white = cvCreateImage(cvGetSize(input_frame), input_frame->depth, 1);
+    cvSet(white, cvScalar(255));
+    fov_img = cvCreateImage(cvSize(MAP_MAX, MAP_MAX), 8, 1);
+    cvWarpPerspective(white, fov_img, warp_matrix, CV_INTER_LINEAR | CV_WARP_INVERSE_MAP | CV_WARP_FILL_OUTLIERS);
+    cvReleaseImage(&white);
 }
 
 void populateLanes(IplImage *img) {
     int i, j;
-    pthread_mutex_lock(&camera_map_mutex);
+    map_snapshot *out = camera_map_buffer.beginWrite();
+    if (out == NULL) {
+        ROS_WARN("[LANE] All map buffers are in use, dropping this frame");
+        return;
+    }
+
+    // img is the MAP_MAX square warp_img, already in the image frame
     for (i = 0; i < img->height; i++) {
-        uchar *data = (uchar *) (img->imageData + (MAP_MAX - i) * img->widthStep);
+        uchar *data = (uchar *) (img->imageData + (MAP_MAX - 1 - i) * img->widthStep);
+        uchar *row = out->image.ptr<uchar > (MAP_MAX - 1 - i);
         for (j = 0; j < img->width; j++) {
-            camera_map[j][i] = data[j];
+            out->cells[j][i] = data[j];
+            row[j] = data[j];
         }
     }
-    pthread_mutex_unlock(&camera_map_mutex);
+    camera_map_buffer.publish(out);
 }
 
 void LaneDetection::markLane(const sensor_msgs::ImageConstPtr& image) {
@@ -164,6 +186,19 @@ void LaneDetection::markLane(const sensor_msgs::ImageConstPtr& image) {
         cvShowImage("Lane Map", warp_img);
         cvWaitKey(WAIT_TIME);
     }
-    cvDilate(warp_img, warp_img, ker1, EXPANSION);
+    // Cells in view are lane or free now, the others keep what was seen of them
+    lane_grid.move(lane_motion.update());
+    for (int i = 0; i < MAP_MAX; i++) {
+        uchar *fov = (uchar *) (fov_img->imageData + i * fov_img->widthStep);
+        uchar *lane = (uchar *) (warp_img->imageData + i * warp_img->widthStep);
+        for (int j = 0; j < MAP_MAX; j++) {
+            if (fov[j] == 255) {
+                lane_grid.observe(j, MAP_MAX - 1 - i, lane[j] == 255);
+            }
+        }
+    }
+    lane_grid.render((uchar *) warp_img->imageData, warp_img->widthStep);
+
+    inflateMap(warp_img, EXPANSION, inflate_dist);
     populateLanes(warp_img);
 }
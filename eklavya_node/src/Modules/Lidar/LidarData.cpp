@@ -1,5 +1,14 @@
 #include "LidarData.h"
+#include "../../Utils/EgoMotion/ego_motion.h"
+#include "../../Utils/MapBuffer/map_buffer.h"
+#include "../../Utils/RollingGrid/rolling_grid.h"
 #include <cvblob.h>
+#include <errno.h>
+#include <limits.h>
+#include <map>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
 
 /*  Filter:
  *  0: No filter
@@ -13,45 +22,248 @@
 #define CENTERY 100
 #define HOKUYO_SCALE 100
 #define RADIUS 30
-#define EXPAND_ITER 60
+#define EXPAND_ITER 60 // cells obstacles are inflated by
+#define LIDAR_PARAMETERS_DIR "../src/Modules/Lidar"
+#define LIDAR_PARAMETERS_NAME "lidar_parameters.txt"
+#define LIDAR_PARAMETERS_FILE LIDAR_PARAMETERS_DIR "/" LIDAR_PARAMETERS_NAME
+/// Where the scan painting below puts range 0, the beams of the rolling grid start here
+#define LIDAR_ORIGIN_Y (CENTERY + 60)
+/**
+ * Blob tracking: blobs left by the blob filter are matched across scans by
+ * cvUpdateTracks and published in obstacles with their velocity over the
+ * ground. Velocities are smoothed by LIDAR_TRACK_SMOOTHING per scan.
+ */
+#define LIDAR_TRACK_DISTANCE 50 // cells a blob may move between scans and keep its track
+#define LIDAR_TRACK_INACTIVE 5 // scans a track survives without its blob
+#define LIDAR_TRACK_SMOOTHING 0.3
+
 #define intensity(img,i,j,n) *(uchar*)(img->imageData + img->widthStep*i + j*img->nChannels + n) 
 #define IMGDATA(image,i,j,k) (((uchar *)image->imageData)[(i)*(image->widthStep) + (j)*(image->nChannels) + (k)])
 #define IMGDATAG(image,i,j) (((uchar *)image->imageData)[(i)*(image->widthStep) + (j)])
 
-void LidarData::update_map(const sensor_msgs::LaserScan& scan) {
+typedef struct track_motion {
+    double x, y; // centroid at the last scan, in the bot frame of that scan
+    double vx, vy;
+    double time;
+    bool moved; // has a velocity estimate
+} track_motion;
 
-    //TODO: Fusion needs to be implemented in the STRATEGY module
+/**
+ * Matches blobs to the tracks of earlier scans and publishes the active
+ * tracks. The bot's own motion (motion, see EgoMotion) is taken out, so a
+ * blob keeps still while the bot drives past it.
+ */
+static void trackObstacles(const cvb::CvBlobs& blobs, double time, TripletFP motion) {
+    static cvb::CvTracks tracks;
+    static map<cvb::CvID, track_motion> motions;
+
+    cvb::cvUpdateTracks(blobs, tracks, LIDAR_TRACK_DISTANCE, LIDAR_TRACK_INACTIVE);
+
+    // Last scan's bot frame to this one's, about the bot
+    double a = -motion.z * CV_PI / 180;
+
+    // The planner keeps wall time (see EgoMotion), the scan's age is carried over to it
+    double wall_stamp = ros::WallTime::now().toSec() - (ros::Time::now().toSec() - time);
+
+    vector<Obstacle> tracked;
+    for (cvb::CvTracks::const_iterator it = tracks.begin(); it != tracks.end(); ++it) {
+        const cvb::CvTrack *track = it->second;
+        if (track->inactive > 0) {
+            continue;
+        }
+
+        // Image rows run against the map's y
+        double x = track->centroid.x;
+        double y = MAP_MAX - 1 - track->centroid.y;
+
+        map<cvb::CvID, track_motion>::iterator m = motions.find(track->id);
+        if (m == motions.end()) {
+            track_motion first = {x, y, 0, 0, time, false};
+            m = motions.insert(make_pair(track->id, first)).first;
+        } else if (time > m->second.time) {
+            double dx = m->second.x - CENTERX - motion.x;
+            double dy = m->second.y - CENTERY - motion.y;
+            double last_x = CENTERX + dx * cos(a) - dy * sin(a);
+            double last_y = CENTERY + dx * sin(a) + dy * cos(a);
+
+            double dt = time - m->second.time;
+            double vx = (x - last_x) / dt;
+            double vy = (y - last_y) / dt;
+            double k = m->second.moved ? LIDAR_TRACK_SMOOTHING : 1;
+            m->second.vx += k * (vx - m->second.vx);
+            m->second.vy += k * (vy - m->second.vy);
+            m->second.moved = true;
+            m->second.x = x;
+            m->second.y = y;
+            m->second.time = time;
+        }
 
-    //initialize variables
-    if (DEBUG){
-        cvNamedWindow("Control Box", 1);
+        if (!m->second.moved) {
+            continue;
+        }
+
+        Obstacle obstacle;
+        obstacle.id = track->id;
+        obstacle.x = x;
+        obstacle.y = y;
+        obstacle.vx = m->second.vx;
+        obstacle.vy = m->second.vy;
+        obstacle.radius = 0.5 * sqrt((double) ((track->maxx - track->minx) * (track->maxx - track->minx) +
+                (track->maxy - track->miny) * (track->maxy - track->miny))) + EXPAND_ITER;
+        obstacle.stamp = wall_stamp;
+        tracked.push_back(obstacle);
     }
-    
-    int minblob_lidar = 150, s=5;
-    fstream file;
-    file.open("../src/Modules/Lidar/lidar_parameters.txt", ios::in);
-    file>>minblob_lidar>>s;
-    file.close();
 
-    cvCreateTrackbar("minblob_lidar", "Control Box", &minblob_lidar, 1000, &writeVal);
-    cvCreateTrackbar("kernel 1", "Control Box", &s, 20, &writeVal);
-        
+    // Forget the motion of tracks cvUpdateTracks dropped
+    for (map<cvb::CvID, track_motion>::iterator m = motions.begin(); m != motions.end();) {
+        if (tracks.find(m->first) == tracks.end()) {
+            motions.erase(m++);
+        } else {
+            ++m;
+        }
+    }
+
+    pthread_mutex_lock(&obstacles_mutex);
+    obstacles.swap(tracked);
+    pthread_mutex_unlock(&obstacles_mutex);
+}
+
+/**
+ * The scan pipeline's images, kernels and parameters, set up on the first
+ * scan and kept for the next ones. Parameters come from
+ * LIDAR_PARAMETERS_FILE (minimum blob area, blob kernel size). The file is
+ * read again only when inotify reports that it was written; on the scan
+ * path that costs one non-blocking read of the inotify descriptor.
+ */
+class LidarPipeline {
+public:
+
+    LidarPipeline() : minblob_lidar(150), s(5), kernel_size(0), ker1(NULL), notify_fd(-1) {
+        img = cvCreateImage(cvSize(MAP_MAX, MAP_MAX), 8, 1);
+        labelImg = cvCreateImage(cvSize(MAP_MAX, MAP_MAX), IPL_DEPTH_LABEL, 1);
+        nblobs = cvCreateImage(cvSize(MAP_MAX, MAP_MAX), 8, 3);
+        nblobs1 = cvCreateImage(cvSize(MAP_MAX, MAP_MAX), 8, 3);
+        inflate_dist = cvCreateImage(cvSize(MAP_MAX, MAP_MAX), IPL_DEPTH_32F, 1);
+        returns.reserve(2048);
+        misses.reserve(2048);
+
+        readParameters();
+
+        // The directory is watched, editors replace the file rather than write it
+        notify_fd = inotify_init1(IN_NONBLOCK);
+        if (notify_fd < 0 || inotify_add_watch(notify_fd, LIDAR_PARAMETERS_DIR, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+            ROS_WARN("[LIDAR] Unable to watch %s, parameter changes need a restart", LIDAR_PARAMETERS_FILE);
+        }
+
+        if (DEBUG) {
+            cvNamedWindow("Control Box", 1);
+            // The trackbars change the parameters in place, writeVal() saves them
+            cvCreateTrackbar("minblob_lidar", "Control Box", &minblob_lidar, 1000, &LidarData::writeVal);
+            cvCreateTrackbar("kernel 1", "Control Box", &s, 20, &LidarData::writeVal);
+        }
+    }
+
+    void process(const sensor_msgs::LaserScan& scan);
+
+private:
+
+    /// Map cell (y up) where a beam of length dist ends, pulled back along the beam to the map edge
+    static CvPoint beamEnd(float angle, float dist) {
+        double x = -sin(angle) * dist * 100;
+        double y = cos(angle) * dist * 100;
+
+        double t = 1;
+        if (CENTERX + x < 0) {
+            t = min(t, -CENTERX / x);
+        } else if (CENTERX + x > MAP_MAX - 1) {
+            t = min(t, (MAP_MAX - 1 - CENTERX) / x);
+        }
+        if (LIDAR_ORIGIN_Y + y < 0) {
+            t = min(t, -LIDAR_ORIGIN_Y / y);
+        } else if (LIDAR_ORIGIN_Y + y > MAP_MAX - 1) {
+            t = min(t, (MAP_MAX - 1 - LIDAR_ORIGIN_Y) / y);
+        }
+
+        return cvPoint((int) (CENTERX + t * x), (int) (LIDAR_ORIGIN_Y + t * y));
+    }
+
+    void readParameters() {
+        fstream file;
+        file.open(LIDAR_PARAMETERS_FILE, ios::in);
+        file >> minblob_lidar >> s;
+        file.close();
+        ROS_INFO("[LIDAR] Parameters: minblob_lidar %d, kernel %d", minblob_lidar, s);
+    }
+
+    /// Reads the parameters again if their file was written since the last scan
+    void reloadParameters() {
+        if (notify_fd < 0) {
+            return;
+        }
+
+        char events[sizeof (struct inotify_event) + NAME_MAX + 1] __attribute__((aligned(__alignof__(struct inotify_event))));
+        bool changed = false;
+        ssize_t n;
+        while ((n = read(notify_fd, events, sizeof (events))) > 0) {
+            for (char *p = events; p < events + n;) {
+                struct inotify_event *event = (struct inotify_event *) p;
+                if (event->len > 0 && strcmp(event->name, LIDAR_PARAMETERS_NAME) == 0) {
+                    changed = true;
+                }
+                p += sizeof (struct inotify_event) + event->len;
+            }
+        }
+
+        if (changed) {
+            readParameters();
+        }
+    }
+
+    /// The blob kernel for the current s, rebuilt only when s changed
+    IplConvKernel *blobKernel() {
+        int size = max(1, s);
+        if (ker1 == NULL || size != kernel_size) {
+            if (ker1 != NULL) {
+                cvReleaseStructuringElement(&ker1);
+            }
+            ker1 = cvCreateStructuringElementEx(size, size, size / 2, size / 2, CV_SHAPE_ELLIPSE);
+            kernel_size = size;
+        }
+        return ker1;
+    }
+
+    int minblob_lidar, s; // parameters, see LIDAR_PARAMETERS_FILE
+    int kernel_size; // of ker1
+    IplConvKernel *ker1;
+    int notify_fd;
+
     IplImage *img, *nblobs, *nblobs1, *labelImg;
-    img = cvCreateImage(cvSize(MAP_MAX, MAP_MAX), 8, 1);
+    IplImage *inflate_dist; // scratch of inflateMap()
+    vector<CvPoint> returns; // image cells of the beams that hit something
+    vector<CvPoint> misses; // map cells (y up) where beams with no return in the map end
+
+    EgoMotion ego_motion;
+    // Scans are accumulated here, so an obstacle missed by one scan stays on the map
+    RollingGrid grid;
+};
+
+void LidarPipeline::process(const sensor_msgs::LaserScan& scan) {
+    TripletFP motion = ego_motion.update();
+
+    //TODO: Fusion needs to be implemented in the STRATEGY module
+
+    reloadParameters();
     cvSet(img, cvScalar(0));
 
-    //TODO: put kernel initialization in constructor
-    IplConvKernel *ker1, *ker2;
-    cvb::CvBlobs blobs;
     uchar * ptr;
 
-    //initialize variables ended
-
     //Taking data from hokuyo node
 
     size_t size = scan.ranges.size();
     float angle = scan.angle_min;
     float maxRangeForContainer = scan.range_max - 0.1f;
+    returns.clear();
+    misses.clear();
 
     for (size_t i = 0; i < size; ++i) {
         float dist = scan.ranges[i];
@@ -61,13 +273,20 @@ void LidarData::update_map(const sensor_msgs::LaserScan& scan) {
             int x = (int) ((x1 * 100) + CENTERX);
             int y = (int) ((y1 * 100) + CENTERY + 30);
 
-            if (x >= 0 && y >= 0 && (int) x < MAP_MAX && (int) y < MAP_MAX) {
+            // The row below is shifted by another 30, so y must leave room for it
+            if (x >= 0 && y >= 0 && (int) x < MAP_MAX && (int) y + 30 < MAP_MAX) {
                 int x2 = (x);
                 int y2 = (MAP_MAX - y - 30 - 1);
 
                 ptr = (uchar *) (img->imageData + y2 * img->widthStep);
                 ptr[x2] = 255;
+                returns.push_back(cvPoint(x2, y2));
+            } else {
+                misses.push_back(beamEnd(angle, dist));
             }
+        } else if (dist >= maxRangeForContainer) {
+            // No return (range_max or inf): nothing up to the range limit
+            misses.push_back(beamEnd(angle, scan.range_max));
         }
         angle += scan.angle_increment;
     }
@@ -87,32 +306,24 @@ void LidarData::update_map(const sensor_msgs::LaserScan& scan) {
         }
         case 1:
         {
-            labelImg = cvCreateImage(cvSize(MAP_MAX, MAP_MAX), IPL_DEPTH_LABEL, 1);
-            nblobs = cvCreateImage(cvSize(MAP_MAX, MAP_MAX), 8, 3);
-            nblobs1 = cvCreateImage(cvSize(MAP_MAX, MAP_MAX), 8, 3);
+            cvb::CvBlobs blobs;
             cvSet(labelImg, cvScalar(0));
+            cvSet(nblobs, cvScalar(0));
+            cvSet(nblobs1, cvScalar(0));
 
-            ker1 = cvCreateStructuringElementEx(s, s, 2, 2, CV_SHAPE_ELLIPSE);
-            ker2 = cvCreateStructuringElementEx(7, 7, 3, 3, CV_SHAPE_ELLIPSE);
-            cvDilate(img, img, ker1, 1);
-            //cvErode(filtered_img,filtered_img,ker2,1);
+            cvDilate(img, img, blobKernel(), 1);
             unsigned int result = cvLabel(img, labelImg, blobs);
             cvRenderBlobs(labelImg, blobs, nblobs, nblobs, CV_BLOB_RENDER_COLOR);
             cvFilterByArea(blobs, minblob_lidar, img->height * img->width);
+            trackObstacles(blobs, scan.header.stamp.toSec(), motion);
             cvRenderBlobs(labelImg, blobs, nblobs1, nblobs1, CV_BLOB_RENDER_COLOR);
             //converts nblobs1 to filtered_img(grayscale)
             cvCvtColor(nblobs1, img, CV_RGB2GRAY);
             //thresholds the filtered_img based on threshold value
             cvThreshold(img, img, 125, 255, CV_THRESH_BINARY);
 
-            cvReleaseImage(&labelImg);
-            cvReleaseImage(&nblobs);
-            cvReleaseImage(&nblobs1);
             cvReleaseBlobs(blobs);
 
-            cvReleaseStructuringElement(&ker1);
-            cvReleaseStructuringElement(&ker2);
-
             if (DEBUG) {
                 cvNamedWindow("Blob Filter", 0);
                 cvResize(img, showImg2);
@@ -123,9 +334,19 @@ void LidarData::update_map(const sensor_msgs::LaserScan& scan) {
         }
     }
 
-    ker1 = cvCreateStructuringElementEx(3, 3, 1, 1, CV_SHAPE_ELLIPSE);
-    cvDilate(img, img, ker1, EXPAND_ITER);
-    cvReleaseStructuringElement(&ker1);
+    // Every beam frees the cells on its way; it marks its end only if that survived the filter
+    grid.move(motion);
+    for (unsigned int i = 0; i < returns.size(); i++) {
+        bool hit = IMGDATA(img, returns[i].y, returns[i].x, 0) == 255;
+        grid.ray(CENTERX, LIDAR_ORIGIN_Y, returns[i].x, MAP_MAX - 1 - returns[i].y, hit);
+    }
+    // Beams with no return in the map clear their whole way, else an obstacle that moved off stays forever
+    for (unsigned int i = 0; i < misses.size(); i++) {
+        grid.ray(CENTERX, LIDAR_ORIGIN_Y, misses[i].x, misses[i].y, false);
+    }
+    grid.render((uchar *) img->imageData, img->widthStep);
+
+    inflateMap(img, EXPAND_ITER, inflate_dist);
 
     if (DEBUG) {
         cvNamedWindow("Dilate Filter", 0);
@@ -134,19 +355,28 @@ void LidarData::update_map(const sensor_msgs::LaserScan& scan) {
         cvWaitKey(WAIT_TIME);
     }
 
-    pthread_mutex_lock(&lidar_map_mutex);
-    for (int i = 0; i < MAP_MAX; i++) {
-        for (int j = 0; j < MAP_MAX; j++) {
-            lidar_map[i][j] = IMGDATA(img, MAP_MAX - j - 1, i, 0);
+    map_snapshot *out = lidar_map_buffer.beginWrite();
+    if (out == NULL) {
+        ROS_WARN("[LIDAR] All map buffers are in use, dropping this scan");
+    } else {
+        for (int i = 0; i < MAP_MAX; i++) {
+            for (int j = 0; j < MAP_MAX; j++) {
+                out->cells[i][j] = IMGDATA(img, MAP_MAX - j - 1, i, 0);
+                out->image.at<uchar > (MAP_MAX - 1 - j, i) = out->cells[i][j];
+            }
         }
+        lidar_map_buffer.publish(out);
     }
-    pthread_mutex_unlock(&lidar_map_mutex);
-    cvReleaseImage(&img);
+}
+
+void LidarData::update_map(const sensor_msgs::LaserScan& scan) {
+    static LidarPipeline pipeline;
+    pipeline.process(scan);
 }
 
 void LidarData::writeVal(int val){
     fstream file;
-    file.open("../src/Modules/Lidar/lidar_parameters.txt", ios::out);
+    file.open(LIDAR_PARAMETERS_FILE, ios::out);
     file<<cvGetTrackbarPos("minblob_lidar", "Control Box")<<endl;
     file<<cvGetTrackbarPos("kernel 1", "Control Box")<<endl;
     file.close();
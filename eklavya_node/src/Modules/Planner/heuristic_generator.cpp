@@ -0,0 +1,40 @@
+/**
+ * Generates a heuristic table for a seed set:
+ *
+ *   heuristic_generator [seeds_file table_file]
+ *
+ * Without arguments, the planner's HEURISTIC_FILE for the compiled in
+ * SEEDS_FILE. Run from bin/, like the node, after changing the seeds; the
+ * portfolio configurations name their tables the same way (seedsN.txt,
+ * heuristicN.lut).
+ */
+
+#include "planner.h"
+
+/* Globals the planner expects from the node */
+Pose pose;
+vector<Triplet> path;
+pthread_mutex_t pose_mutex;
+pthread_mutex_t path_mutex;
+
+char **local_map;
+int ol_overflow;
+int last_cmd;
+
+int main(int argc, char **argv) {
+    pthread_mutex_init(&pose_mutex, NULL);
+    pthread_mutex_init(&path_mutex, NULL);
+
+    if (argc != 1 && argc != 3) {
+        ROS_ERROR("usage: heuristic_generator [seeds_file table_file]");
+        return 1;
+    }
+
+    ros::WallTime start = ros::WallTime::now();
+    if (!planner_space::Planner::buildHeuristicTable(argc == 3 ? argv[1] : NULL, argc == 3 ? argv[2] : NULL)) {
+        return 1;
+    }
+    ROS_INFO("[PLANNER] Heuristic table generated in %.1lf s", (ros::WallTime::now() - start).toSec());
+
+    return 0;
+}
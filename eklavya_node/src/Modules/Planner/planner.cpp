@@ -1,5 +1,9 @@
 #include "planner.h"
 #include "plannerMethods.h"
+#include "plannerIncremental.h"
+#include "plannerSearch.h"
+#include "plannerHybrid.h"
+#include "plannerPortfolio.h"
 
 using namespace cv;
 namespace planner_space {
@@ -24,39 +28,152 @@ namespace planner_space {
     }
     
     void Planner::loadPlanner() {
-        loadSeeds();
+        if (!loadSeeds(SEEDS_FILE, seeds)) {
+            ROS_ERROR("[PLANNER] Unable to open %s", SEEDS_FILE);
+            Planner::finBot();
+            exit(1);
+        }
         ROS_INFO("[PLANNER] Seeds Loaded");
 
+        seed_table.build(seeds);
+        ROS_INFO("[PLANNER] Seed Tables Built");
+
+        if (heuristic_table.load(HEURISTIC_FILE, seeds)) {
+            ROS_INFO("[PLANNER] Heuristic Table Loaded");
+        } else {
+            ROS_WARN("[PLANNER] No heuristic table for %s, using euclidean distance", SEEDS_FILE);
+        }
+
+        allocateLattice();
+        ROS_INFO("[PLANNER] Lattice Allocated");
+
         initBot();
         ROS_INFO("[PLANNER] Vehicle Initiated");
     }
 
-    geometry_msgs::Twist Planner::findPath(Triplet bot, Triplet target, Mat data_img) {
-        state start, goal;
+    bool Planner::buildHeuristicTable(const char *seeds_file, const char *table_file) {
+        if (seeds_file == NULL) {
+            seeds_file = SEEDS_FILE;
+            table_file = HEURISTIC_FILE;
+        }
 
-        start.pose = bot;
-        start.seed_id = -1;
-        start.g_dist = 0;
-        start.h_dist = distance(bot, target);
-        start.g_obs = 0;
-        start.h_obs = 0;
-        start.depth = 0;
+        vector<seed> table_seeds;
+        if (!loadSeeds(seeds_file, table_seeds)) {
+            ROS_ERROR("[PLANNER] Unable to open %s", seeds_file);
+            return false;
+        }
 
-        goal.pose = target;
-        goal.g_dist = 0;
-        goal.h_dist = 0;
-        goal.seed_id = 0;
-        goal.g_obs = 0;
-        goal.h_obs = 0;
+        HeuristicTable table;
+        table.generate(table_seeds);
+        if (!table.save(table_file, table_seeds)) {
+            ROS_ERROR("[PLANNER] Unable to write %s", table_file);
+            return false;
+        }
+        return true;
+    }
+
+    void Planner::updateCostField(Mat map_img) {
+        cost_field.update(map_img);
+    }
+
+    void Planner::updateOccupancy() {
+        occupancy.pack(local_map);
+        coarse_grid.pool(occupancy);
+    }
+
+    void Planner::updateObstacles(const vector<Obstacle>& tracked, double now) {
+        obstacle_prediction.update(tracked, now);
+        dynamic_occupancy = occupancy;
+        obstacle_prediction.clearCurrent(dynamic_occupancy);
+    }
+
+    void Planner::updateEgoMotion(TripletFP motion, double now) {
+        path_reuse.move(motion);
+        obstacle_prediction.move(motion, now);
+        incremental_planner.move(motion);
+    }
 
-        vector<state> open_list;
-        open_list.insert(open_list.begin(), start);
-        map<Triplet, open_map_element, PoseCompare> open_map;
-        open_map[start.pose].membership = OPEN;
-        open_map[start.pose].cost = start.g_dist;
+    /// Command for the outcome of a LatticeSearch on ws, an overflow is reported by the caller
+    geometry_msgs::Twist searchCommand(SearchStatus status, int goal_node, Mat data_img, const SearchWorkspace& ws = main_workspace) {
         geometry_msgs::Twist cmdvel;
-        map<Triplet, state, PoseCompare> came_from;
 
+        if (status == SearchStartBlocked) {
+            ROS_WARN("[PLANNER] Robot is in Obstacles");
+            Planner::finBot();
+            return cmdvel;
+        }
+
+        if (status == SearchNoPath) {
+            ROS_ERROR("[PLANNER] No Path Found");
+            closePlanner();
+            cmdvel = kTurn();
+            return cmdvel;
+        }
+
+        cmdvel = reconstructPath(ws, goal_node, data_img);
+        last_cmd = cmdvel.angular.z > 0 ? LEFT_CMD : RIGHT_CMD;
+
+#ifdef DEBUG
+        ROS_INFO("[PLANNER] Path Found");
+        cv::imshow("[PLANNER] Map", data_img);
+        cvWaitKey(0);
+#endif
+
+#ifdef SHOW_PATH
+        cv::imshow("[PLANNER] Map", data_img);
+        cvWaitKey(WAIT_TIME);
+#endif
+        closePlanner();
+
+        return cmdvel;
+    }
+
+    /// Follows the path of an earlier cycle if it is still free and still reaches goal_region
+    bool reusePath(const state& start, Mat data_img, geometry_msgs::Twist *cmdvel) {
+        double cost;
+        int first = path_reuse.follow(start.pose, occupancy, &cost);
+
+        state end;
+        end.pose = path_reuse.end(start.pose);
+        if (first == -1 || !(isEqual(end, goal_region) || onTarget(end, goal_region))) {
+            path_reuse.clear();
+            return false;
+        }
+
+        search_stats.expansions = 0;
+        search_stats.peak_open = 0;
+        search_stats.path_cost = cost;
+        search_stats.collision_checks = 0;
+
+        pthread_mutex_lock(&path_mutex);
+        path.clear();
+        for (int i = first; i < path_reuse.size(); i++) {
+            Triplet pose = path_reuse.stepEnd(i, start.pose);
+#if defined SHOW_PATH || defined DEBUG
+            plotPoint(data_img, pose);
+#endif
+            path.push_back(pose);
+        }
+        path_tracker.follow(path, start.pose);
+        pthread_mutex_unlock(&path_mutex);
+
+        *cmdvel = sendCommand(path_reuse.stepSeed(first));
+        last_cmd = cmdvel->angular.z > 0 ? LEFT_CMD : RIGHT_CMD;
+
+#ifdef SHOW_PATH
+        cv::imshow("[PLANNER] Map", data_img);
+        cvWaitKey(WAIT_TIME);
+#endif
+        return true;
+    }
+
+    geometry_msgs::Twist Planner::findPath(Triplet bot, Triplet target, Mat data_img) {
+        data_img = drawableMap(data_img);
+        state start;
+        start.pose = bot;
+        goal_region.set(target);
+
+        geometry_msgs::Twist cmdvel;
         brake.vl = brake.vr = 0;
         //	leftZeroTurn.vl=-15;leftZeroTurn.vr=15;
         //	rightZeroTurn.vl=15;rightZeroTurn.vr=-15;
@@ -74,423 +191,548 @@ namespace planner_space {
         //		return precmdvel;
         //		}
         //	}
-        if (isEqual(start, goal)) {
+        if (isEqual(start, goal_region)) {
             ROS_INFO("[PLANNER] Target Reached");
             Planner::finBot();
             return cmdvel;
         }
 
-        int iterations = 0;
-        while (!open_list.empty()) {
-            //TODO: This condition needs to be handled in the strategy module.
-            if (local_map[start.pose.x][start.pose.y] > 0) {
-                ROS_WARN("[PLANNER] Robot is in Obstacles");
-                Planner::finBot();
-                return cmdvel;
-            }
+#ifdef PATH_REUSE
+        if (reusePath(start, data_img, &cmdvel)) {
+            return cmdvel;
+        }
+#endif
 
-            state current = open_list.front();
+        int goal_node;
+        SearchStatus status = SearchNoPath;
+#ifdef COARSE_CORRIDOR
+        if (coarse_grid.plan(bot, goal_region)) {
+            CorridorHeuristic corridor_h(target);
+            CorridorSearch corridor_search(main_workspace, LengthCost(), corridor_h, LatticeSuccessors(), CorridorCollision());
+            status = corridor_search.run(start, data_img, &goal_node);
+        }
+#endif
 
-#ifdef DEBUG
-            cout << "==> CURRENT: ";
-            print(current);
+        // No corridor, or no lattice path inside it; an overflow would only overflow again
+        if (status == SearchNoPath) {
+            LatticeHeuristic h(target);
+            PlainSearch search(main_workspace, LengthCost(), h, LatticeSuccessors(), LatticeCollision());
+            status = search.run(start, data_img, &goal_node);
+        }
 
-            plotPoint(data_img, current.pose);
-            cv::imshow("[PLANNER] Map", data_img);
+        if (status == SearchOverflow) {
+            ROS_WARN("[PLANNER] Open List Overflow");
+            Planner::finBot();
+            return cmdvel;
+        }
 
-            cvWaitKey(0);
-#endif
+        return searchCommand(status, goal_node, data_img);
+    }
 
-            if ((open_map.find(current.pose) != open_map.end()) &&
-                    (open_map[current.pose].membership == CLOSED)) {
-                pop_heap(open_list.begin(), open_list.end(), StateCompare());
-                open_list.pop_back();
-                continue;
-            }
+    geometry_msgs::Twist Planner::findPathDT(Triplet bot, Triplet target, Mat data_img) {
+        data_img = drawableMap(data_img);
+        state start, goal;
+        start.pose = bot;
+        goal.pose = target;
+        goal_region.set(target);
 
-            if (isEqual(current, goal)) {
-                cmdvel = reconstructPath(came_from, current, data_img);
-                last_cmd = cmdvel.angular.z > 0 ? LEFT_CMD : RIGHT_CMD;
+        geometry_msgs::Twist cmdvel;
+        brake.vl = brake.vr = 0;
 
-#ifdef DEBUG
-                ROS_INFO("[PLANNER] Path Found");
+        //        addObstacleP(data_img, 450, 500, 30);
+        //        addObstacleP(data_img, 460, 500, 30);
+        //        addObstacleP(data_img, 470, 500, 30);
+        //        addObstacleP(data_img, 480, 500, 30);
+        //        addObstacleP(data_img, 490, 500, 30);
+        //        addObstacleP(data_img, 500, 500, 30);
+        //        addObstacleP(data_img, 510, 500, 30);
+        //        addObstacleP(data_img, 520, 500, 30);
+        //        addObstacleP(data_img, 530, 500, 30);
+        //        addObstacleP(data_img, 540, 500, 30);
+        //        addObstacleP(data_img, 550, 500, 30);
+        //
+        //        addObstacleP(data_img, 100 + rand() % 600, 100 + rand() % 600, 10);
+        //        addObstacleP(data_img, 100 + rand() % 600, 100 + rand() % 600, 10);
+        //        addObstacleP(data_img, 100 + rand() % 600, 100 + rand() % 600, 10);
+        //        addObstacleP(data_img, 100 + rand() % 600, 100 + rand() % 600, 10);
+        //        addObstacleP(data_img, 100 + rand() % 600, 100 + rand() % 600, 10);
 
-                cv::imshow("[PLANNER] Map", data_img);
+        if (!cost_field.ready()) {
+            cost_field.update(data_img);
+        }
 
-                cvWaitKey(0);
-#endif
-                //                Mat hoho;
-                //                resize(data_img, hoho, cvSize(400, 400));
-#ifdef SHOW_PATH
+        if (targetReached(start, goal)) {
+            ROS_INFO("[PLANNER] Target Reached");
+            Planner::finBot();
+            return cmdvel;
+        }
 
-                cv::imshow("[PLANNER] Map", data_img);
-                cvWaitKey(WAIT_TIME);
+#ifdef PATH_REUSE
+        if (reusePath(start, data_img, &cmdvel)) {
+            return cmdvel;
+        }
 #endif
-                closePlanner();
-                //		precmdvel=cmdvel;
-                return cmdvel;
-            }
 
-            if (onTarget(current, goal)) {
-                cmdvel = reconstructPath(came_from, current, data_img);
-                last_cmd = cmdvel.angular.z > 0 ? LEFT_CMD : RIGHT_CMD;
-
-#ifdef DEBUG
-                ROS_INFO("[PLANNER] Path Found");
-                cv::imshow("[PLANNER] Map", data_img);
-                cvWaitKey(0);
+        int goal_node;
+        ClearanceCost clearance(target);
+        SearchStatus status = SearchNoPath;
+#ifdef COARSE_CORRIDOR
+        if (coarse_grid.plan(bot, goal_region)) {
+            CorridorHeuristic corridor_h(target);
+            ClearanceCorridorSearch corridor_search(main_workspace, clearance, corridor_h, LatticeSuccessors(), CorridorCollision());
+            status = corridor_search.run(start, data_img, &goal_node);
+        }
 #endif
 
-#ifdef SHOW_PATH
+        if (status == SearchNoPath) {
+            LatticeHeuristic h(target);
+            ClearanceSearch search(main_workspace, clearance, h, LatticeSuccessors(), LatticeCollision());
+            status = search.run(start, data_img, &goal_node);
+        }
 
-                cv::imshow("[PLANNER] Map", data_img);
-                cvWaitKey(WAIT_TIME);
-#endif
-                closePlanner();
-                //		precmdvel=cmdvel;
-                return cmdvel;
-            }
+        if (status == SearchOverflow) {
+            ROS_WARN("[PLANNER] DT Open List Overflow - RETRYING w/o DT");
+            ol_overflow = 1;
+            Planner::finBot();
+            return cmdvel;
+        }
 
-            pop_heap(open_list.begin(), open_list.end(), StateCompare());
-            open_list.pop_back();
-            open_map[current.pose].membership = UNASSIGNED;
-            open_map[current.pose].cost = -1;
+        return searchCommand(status, goal_node, data_img);
+    }
 
-            open_map[current.pose].membership = CLOSED;
+    geometry_msgs::Twist Planner::findPathIncremental(Triplet bot, Triplet target, Mat data_img) {
+        data_img = drawableMap(data_img);
+        state start;
+        start.pose = bot;
+        goal_region.set(target);
 
-            vector<state> neighbors = neighborNodes(current);
+        geometry_msgs::Twist cmdvel;
+        brake.vl = brake.vr = 0;
 
-            for (unsigned int i = 0; i < neighbors.size(); i++) {
-                state neighbor = neighbors[i];
+        if (isEqual(start, goal_region)) {
+            ROS_INFO("[PLANNER] Target Reached");
+            Planner::finBot();
+            return cmdvel;
+        }
 
-#ifdef DEBUG
-                //plotPoint(grayImg,neighbor.pose);
-#endif
+        //TODO: This condition needs to be handled in the strategy module.
+        if (local_map[start.pose.x][start.pose.y] > 0) {
+            ROS_WARN("[PLANNER] Robot is in Obstacles");
+            Planner::finBot();
+            return cmdvel;
+        }
 
-                if (!(((neighbor.pose.x >= 0) && (neighbor.pose.x < MAP_MAX)) &&
-                        ((neighbor.pose.y >= 0) && (neighbor.pose.y < MAP_MAX)))) {
-                    continue;
-                }
+        int start_node;
+        IncrementalStatus status = incremental_planner.plan(bot, target, occupancy, &start_node);
+        search_stats.expansions = incremental_planner.expansionCount();
+        search_stats.peak_open = incremental_planner.peakOpen();
+        search_stats.collision_checks = incremental_planner.collisionChecks();
+        search_stats.path_cost = status == IncrementalPathFound ? incremental_planner.pathCost(start_node) : -1;
 
-                if (!isWalkable(current, neighbor)) {
-                    continue;
-                }
+        if (status == IncrementalBudgetExceeded) {
+            ROS_WARN("[PLANNER] Incremental search budget exceeded, resuming next cycle");
+            Planner::finBot();
+            return cmdvel;
+        }
 
-                double tentative_g_score = neighbor.g_dist + current.g_dist;
-                double admissible = distance(neighbor.pose, goal.pose);
-                double consistent = admissible;
-
-                // If already in open_list update cost and came_from if cost is less
-                // This update is implicit since we allow duplicates in open list
-                if (!((open_map.find(neighbor.pose) != open_map.end()) &&
-                        (open_map[neighbor.pose].membership == OPEN))) {
-                    came_from[neighbor. pose] = current;
-                    neighbor.g_dist = tentative_g_score;
-                    neighbor.h_dist = consistent;
-
-                    //next condition is always true
-                    if (!((open_map.find(neighbor.pose) != open_map.end()) &&
-                            (open_map[neighbor.pose].membership == OPEN))) {
-                        open_list.push_back(neighbor);
-                        push_heap(open_list.begin(), open_list.end(), StateCompare());
-                        open_map[neighbor.pose].membership = OPEN;
-                        open_map[neighbor.pose].cost = neighbor.g_dist;
-                    }
-                }
-            }
+        if (status == IncrementalNoPath) {
+            ROS_ERROR("[PLANNER] No Path Found");
+            closePlanner();
+            cmdvel = kTurn();
+            return cmdvel;
+        }
 
-            iterations++;
-            if (iterations > MAX_ITER) {
-                ROS_WARN("[PLANNER] Open List Overflow");
-                Planner::finBot();
-                return cmdvel;
-            }
+        pthread_mutex_lock(&path_mutex);
+        int seed_id = incremental_planner.extractPath(start_node, path);
+#if defined SHOW_PATH || defined DEBUG
+        for (unsigned int i = 0; i < path.size(); i++) {
+            plotPoint(data_img, path[i]);
+        }
+#endif
+        path_tracker.follow(path, bot);
+        pthread_mutex_unlock(&path_mutex);
+
+        if (seed_id != -1) {
+            cmdvel = sendCommand(seeds[seed_id]);
+            last_cmd = cmdvel.angular.z > 0 ? LEFT_CMD : RIGHT_CMD;
+        } else {
+            ROS_ERROR("[PLANNER] Invalid Command Requested");
+            Planner::finBot();
         }
 
-        ROS_ERROR("[PLANNER] No Path Found");
+#ifdef SHOW_PATH
+        cv::imshow("[PLANNER] Map", data_img);
+        cvWaitKey(WAIT_TIME);
+#endif
         closePlanner();
-        cmdvel = kTurn();
 
         return cmdvel;
     }
 
-    geometry_msgs::Twist Planner::findPathDT(Triplet bot, Triplet target, Mat data_img) {
+    geometry_msgs::Twist Planner::findPathAnytime(Triplet bot, Triplet target, Mat data_img) {
+        ros::WallTime deadline = ros::WallTime::now() + ros::WallDuration(ANYTIME_BUDGET);
+        data_img = drawableMap(data_img);
         state start, goal;
 
         start.pose = bot;
         start.seed_id = -1;
         start.g_dist = 0;
-        start.h_dist = distance(bot, target);
+        start.h_dist = heuristic(bot, target);
         start.g_obs = 0;
         start.h_obs = 0;
         start.depth = 0;
 
         goal.pose = target;
+        goal_region.set(target);
         goal.g_dist = 0;
         goal.h_dist = 0;
         goal.seed_id = 0;
         goal.g_obs = 0;
         goal.h_obs = 0;
 
-        double DtThresh=100;
-        vector<state> open_list;
-        open_list.insert(open_list.begin(), start);
-        map<Triplet, open_map_element, PoseCompare> open_map;
-        open_map[start.pose].membership = OPEN;
-        open_map[start.pose].cost = start.g_dist;
         geometry_msgs::Twist cmdvel;
-        map<Triplet, state, PoseCompare> came_from;
-
         brake.vl = brake.vr = 0;
 
-        //        addObstacleP(data_img, 450, 500, 30);
-        //        addObstacleP(data_img, 460, 500, 30);
-        //        addObstacleP(data_img, 470, 500, 30);
-        //        addObstacleP(data_img, 480, 500, 30);
-        //        addObstacleP(data_img, 490, 500, 30);
-        //        addObstacleP(data_img, 500, 500, 30);
-        //        addObstacleP(data_img, 510, 500, 30);
-        //        addObstacleP(data_img, 520, 500, 30);
-        //        addObstacleP(data_img, 530, 500, 30);
-        //        addObstacleP(data_img, 540, 500, 30);
-        //        addObstacleP(data_img, 550, 500, 30);
-        //
-        //        addObstacleP(data_img, 100 + rand() % 600, 100 + rand() % 600, 10);
-        //        addObstacleP(data_img, 100 + rand() % 600, 100 + rand() % 600, 10);
-        //        addObstacleP(data_img, 100 + rand() % 600, 100 + rand() % 600, 10);
-        //        addObstacleP(data_img, 100 + rand() % 600, 100 + rand() % 600, 10);
-        //        addObstacleP(data_img, 100 + rand() % 600, 100 + rand() % 600, 10);
+        if (isEqual(start, goal_region)) {
+            ROS_INFO("[PLANNER] Target Reached");
+            Planner::finBot();
+            return cmdvel;
+        }
 
-        Mat img;
+        //TODO: This condition needs to be handled in the strategy module.
+        if (local_map[start.pose.x][start.pose.y] > 0) {
+            ROS_WARN("[PLANNER] Robot is in Obstacles");
+            Planner::finBot();
+            return cmdvel;
+        }
 
-        Mat dist;
-        img = 255 - data_img;
+        double eps = ANYTIME_EPS_START;
+        double solved_eps = -1;
+        int best_goal = -1;
+        int expansions = 0;
+        bool out_of_time = false;
+        incons.clear();
+
+        resetSearch();
+        int start_node = addNode(start, -1);
+        open_list.push(start_node, anytimeKey(start_node, eps));
+
+        while (true) {
+            // Improve the path with the current inflation
+            while (!open_list.empty()) {
+                if ((best_goal != -1) && (nodes[best_goal].s.g_dist <= open_list.topKey())) {
+                    break;
+                }
 
-        // Marking the boundaries for Voronoi Cost Field
-        int voronoi_border = 10;
-        cv::line(img, cvPoint(voronoi_border, voronoi_border),
-                cvPoint(voronoi_border, MAP_MAX - voronoi_border),
-                CV_RGB(0, 0, 0), 1, CV_AA, 0);
-        cv::line(img, cvPoint(MAP_MAX - voronoi_border, voronoi_border),
-                cvPoint(MAP_MAX - voronoi_border, MAP_MAX - voronoi_border),
-                CV_RGB(0, 0, 0), 1, CV_AA, 0);
+                expansions++;
+                if (((expansions & 63) == 0) && (ros::WallTime::now() > deadline)) {
+                    out_of_time = true;
+                    break;
+                }
 
-        threshold(img, img, 128, 255, THRESH_BINARY);
+                countExpansion();
+                int current_node = open_list.pop();
+                state current = nodes[current_node].s;
+                nodes[current_node].membership = CLOSED;
 
-        dilate(img, img, 5);
-        distanceTransform(img, dist, CV_DIST_L2, 5);
-          for (int i = 0; i < img.rows; i++) {
-            for (int j = 0; j < img.cols; j++) {
-                if (dist.at<float>(i,j)>DtThresh) {
-                    dist.at<float>(i,j)=DtThresh;
+                if (isEqual(current, goal_region) || onTarget(current, goal_region)) {
+                    if ((best_goal == -1) || (current.g_dist < nodes[best_goal].s.g_dist)) {
+                        best_goal = current_node;
+                    }
+                    continue;
                 }
-            }
-        }
 
-        Mat dist1=dist.clone();
-        normalize(dist1, dist1, 0.0, 1.0, NORM_MINMAX);
-        GaussianBlur(dist1, dist1, cvSize(3, 3), 3);
-        Laplacian(dist1, dist1, CV_32F, 1, 1, 0, BORDER_DEFAULT);
+                neighborNodes(current, successors);
+
+                for (unsigned int i = 0; i < successors.size(); i++) {
+                    state neighbor = successors[i];
+
+                    if (!(((neighbor.pose.x >= 0) && (neighbor.pose.x < MAP_MAX)) &&
+                            ((neighbor.pose.y >= 0) && (neighbor.pose.y < MAP_MAX)))) {
+                        continue;
+                    }
+
+                    if (!isWalkable(current, neighbor)) {
+                        continue;
+                    }
 
-        double minVal, maxVal;
-        minMaxLoc(dist1, &minVal, &maxVal);
-        Mat normImage;
-        dist.convertTo(normImage, CV_8U, 255.0 / (maxVal - minVal), -minVal * 255.0 / (maxVal - minVal));
-          for (int i = 0; i < img.rows; i++) {
-            for (int j = 0; j < img.cols; j++) {
-                if (dist.at<float>(i,j)==DtThresh) {
-                    normImage.at<uchar>(i,j)=0;
+                    double tentative_g_score = neighbor.g_dist + current.g_dist;
+                    int n = findNode(neighbor.pose);
+
+                    if (n == -1) {
+                        neighbor.g_dist = tentative_g_score;
+                        neighbor.h_dist = heuristic(neighbor.pose, goal.pose);
+                        int added = addNode(neighbor, current_node);
+                        open_list.push(added, anytimeKey(added, eps));
+                    } else if (tentative_g_score < nodes[n].s.g_dist) {
+                        // The key holds the exact heading, so n is the same state and keeps its pose
+                        nodes[n].s.seed_id = neighbor.seed_id;
+                        nodes[n].s.g_dist = tentative_g_score;
+                        nodes[n].parent = current_node;
+
+                        if (nodes[n].membership == CLOSED) {
+                            // Expanded in this pass already, revisited after tightening
+                            nodes[n].membership = INCONS;
+                            incons.push_back(n);
+                        } else if (nodes[n].membership == OPEN) {
+                            open_list.update(n, anytimeKey(n, eps));
+                        } else if (nodes[n].membership == UNASSIGNED) {
+                            nodes[n].membership = OPEN;
+                            open_list.push(n, anytimeKey(n, eps));
+                        }
+                    }
                 }
             }
-        }
-        //imshow("haha",normImage);
 
-        Mat huhu;
-        threshold(normImage, huhu, 90, 255, THRESH_BINARY);
+            if (out_of_time) {
+                break;
+            }
 
-        // TODO: Need to implement this efficiently
-        for (int i = 0; i < dist.rows; i++) {
-            for (int j = 0; j < dist.cols; j++) {
-                if (i < 20 || i > 980 || j < 20 || j > 980) {
-                    huhu.at<uchar > (i, j) = 255;
-                }
+            if (best_goal == -1) {
+                // Open list exhausted without reaching the target
+                break;
+            }
+
+            solved_eps = eps;
+            if ((eps <= 1.0) || (ros::WallTime::now() > deadline)) {
+                break;
             }
-        }
 
-        Mat final;
-        distanceTransform(huhu, final, CV_DIST_L2, 3);
-        Mat samuel;
-        normalize(final, samuel, 0.0, 1.0, NORM_MINMAX);
-        minMaxLoc(samuel, &minVal, &maxVal);
+            // Tighten: the open list is re-keyed and the inconsistent nodes are reopened
+            eps = eps - ANYTIME_EPS_STEP < 1.0 ? 1.0 : eps - ANYTIME_EPS_STEP;
 
-        Mat dtLaplacian;
-        final.convertTo(dtLaplacian, CV_8U, 255.0 / (maxVal - minVal), -minVal * 255.0 / (maxVal - minVal));
+            reopened.clear();
+            while (!open_list.empty()) {
+                reopened.push_back(open_list.pop());
+            }
+            for (unsigned int i = 0; i < reopened.size(); i++) {
+                open_list.push(reopened[i], anytimeKey(reopened[i], eps));
+            }
+            for (unsigned int i = 0; i < incons.size(); i++) {
+                nodes[incons[i]].membership = OPEN;
+                open_list.push(incons[i], anytimeKey(incons[i], eps));
+            }
+            incons.clear();
 
-        float vdt_max = 0;
-        for (int i = 0; i < dist.rows; i++) {
-            for (int j = 0; j < dist.cols; j++) {
-                if (dist.at<float>(i, j) > vdt_max) {
-                    vdt_max = dist.at<float>(i, j);
+            for (unsigned int i = 0; i < nodes.size(); i++) {
+                if (nodes[i].membership == CLOSED) {
+                    nodes[i].membership = UNASSIGNED;
                 }
             }
         }
 
-        if (targetReached(start, goal)) {
-            ROS_INFO("[PLANNER] Target Reached");
+        if (best_goal != -1) {
+            ROS_DEBUG("[PLANNER] Anytime path with eps %lf after %d expansions", solved_eps, expansions);
+
+            cmdvel = reconstructPath(best_goal, data_img);
+            last_cmd = cmdvel.angular.z > 0 ? LEFT_CMD : RIGHT_CMD;
+
+#ifdef SHOW_PATH
+            cv::imshow("[PLANNER] Map", data_img);
+            cvWaitKey(WAIT_TIME);
+#endif
+            closePlanner();
+            return cmdvel;
+        }
+
+        if (out_of_time) {
+            ROS_WARN("[PLANNER] No Path within the Anytime Budget");
             Planner::finBot();
             return cmdvel;
         }
 
-        int iterations = 0;
-        while (!open_list.empty()) {
-            //TODO: This condition needs to be handled in the strategy module.
-            if (local_map[start.pose.x][start.pose.y] > 0) {
-                ROS_WARN("[PLANNER] Robot is in Obstacles");
-                Planner::finBot();
-                return cmdvel;
-            }
+        ROS_ERROR("[PLANNER] No Path Found");
+        closePlanner();
+        cmdvel = kTurn();
 
-            state current = open_list.front();
+        return cmdvel;
+    }
 
-#ifdef DEBUG
-            cout << "current :g=" << current.g_dist << ":h= " << current.h_dist << ":g_= " << current.g_obs << "iterations : " << current.depth << ":h_= " << current.h_obs << endl;
+    geometry_msgs::Twist Planner::findPathHybrid(Triplet bot, Triplet target, Mat data_img) {
+        data_img = drawableMap(data_img);
+        state start;
+        start.pose = bot;
+        goal_region.set(target);
 
-            plotPoint(data_img, current.pose);
-            cv::imshow("[PLANNER] Map", data_img);
+        geometry_msgs::Twist cmdvel;
+        brake.vl = brake.vr = 0;
 
-            cvWaitKey(0);
-#endif
+        if (isEqual(start, goal_region)) {
+            ROS_INFO("[PLANNER] Target Reached");
+            Planner::finBot();
+            return cmdvel;
+        }
 
+        //TODO: This condition needs to be handled in the strategy module.
+        if (local_map[start.pose.x][start.pose.y] > 0) {
+            ROS_WARN("[PLANNER] Robot is in Obstacles");
+            Planner::finBot();
+            return cmdvel;
+        }
 
-            if ((open_map.find(current.pose) != open_map.end()) &&
-                    (open_map[current.pose].membership == CLOSED)) {
-                pop_heap(open_list.begin(), open_list.end(), StateCompareDT());
-                open_list.pop_back();
-                continue;
-            }
+        int goal_node;
+        search_stats.collision_checks = 0;
+        HybridStatus status = hybrid_planner.plan(bot, target, &goal_node);
+        search_stats.expansions = hybrid_planner.expansionCount();
+        search_stats.peak_open = hybrid_planner.peakOpen();
+        search_stats.path_cost = status == HybridPathFound ? hybrid_planner.pathCost(goal_node) : -1;
 
-            if (isEqual(current, goal)) {
-                cmdvel = reconstructPath(came_from, current, data_img);
-                last_cmd = cmdvel.angular.z > 0 ? LEFT_CMD : RIGHT_CMD;
-                
-#ifdef DEBUG
-                ROS_INFO("[PLANNER] Path Found");
+        if (status == HybridBudgetExceeded) {
+            ROS_WARN("[PLANNER] Open List Overflow");
+            Planner::finBot();
+            return cmdvel;
+        }
 
-                cv::imshow("[PLANNER] Map", data_img);
+        if (status == HybridNoPath) {
+            ROS_ERROR("[PLANNER] No Path Found");
+            closePlanner();
+            cmdvel = kTurn();
+            return cmdvel;
+        }
 
-                cvWaitKey(0);
+        pthread_mutex_lock(&path_mutex);
+        int seed_id = hybrid_planner.extractPath(goal_node, path);
+#if defined SHOW_PATH || defined DEBUG
+        for (unsigned int i = 0; i < path.size(); i++) {
+            plotPoint(data_img, path[i]);
+        }
 #endif
+        path_tracker.follow(path, bot);
+        pthread_mutex_unlock(&path_mutex);
+
+        if (seed_id != -1) {
+            cmdvel = sendCommand(seeds[seed_id]);
+            last_cmd = cmdvel.angular.z > 0 ? LEFT_CMD : RIGHT_CMD;
+        } else {
+            ROS_ERROR("[PLANNER] Invalid Command Requested");
+            Planner::finBot();
+        }
 
 #ifdef SHOW_PATH
-
-                cv::imshow("[PLANNER] Map", data_img);
-                cvWaitKey(WAIT_TIME);
-#endif
-                closePlanner();
-
-                return cmdvel;
-            }
-
-            if (onTarget(current, goal)) {
-                cmdvel = reconstructPath(came_from, current, data_img);
-                last_cmd = cmdvel.angular.z > 0 ? LEFT_CMD : RIGHT_CMD;
-                
-#ifdef DEBUG
-                ROS_INFO("[PLANNER] Path Found");
-                cv::imshow("[PLANNER] Map", data_img);
-                cvWaitKey(0);
+        cv::imshow("[PLANNER] Map", data_img);
+        cvWaitKey(WAIT_TIME);
 #endif
+        closePlanner();
 
-#ifdef SHOW_PATH
+        return cmdvel;
+    }
 
-                cv::imshow("[PLANNER] Map", data_img);
-                cvWaitKey(WAIT_TIME);
-#endif
-                closePlanner();
+    void Planner::finBot() {
+        sendCommand(brake);
+    }
 
-                return cmdvel;
-            }
+    geometry_msgs::Twist Planner::findPathPortfolio(Triplet bot, Triplet target, Mat data_img) {
+        data_img = drawableMap(data_img);
+        state start;
+        start.pose = bot;
+        goal_region.set(target);
 
-            //TODO : why pop_heap 
-            pop_heap(open_list.begin(), open_list.end(), StateCompareDT());
-            open_list.pop_back();
-            open_map[current.pose].membership = UNASSIGNED;
-            open_map[current.pose].cost = -1;
+        geometry_msgs::Twist cmdvel;
+        brake.vl = brake.vr = 0;
 
-            open_map[current.pose].membership = CLOSED;
+        if (isEqual(start, goal_region)) {
+            ROS_INFO("[PLANNER] Target Reached");
+            Planner::finBot();
+            return cmdvel;
+        }
 
-            vector<state> neighbors = neighborNodes(current);
+        if (!portfolio.ready() && !portfolio.start()) {
+            ROS_ERROR("[PLANNER] No portfolio configuration could be loaded");
+            Planner::finBot();
+            return cmdvel;
+        }
 
-            for (unsigned int i = 0; i < neighbors.size(); i++) {
-                state neighbor = neighbors[i];
+        // The DT configuration reads the cost field, planner_thread keeps it current
+        if (!cost_field.ready()) {
+            cost_field.update(data_img);
+        }
 
-#ifdef DEBUG
-                plotPoint(img, neighbor.pose);
+#ifdef PATH_REUSE
+        if (reusePath(start, data_img, &cmdvel)) {
+            return cmdvel;
+        }
 #endif
 
-                if (!(((neighbor.pose.x >= 0) && (neighbor.pose.x < MAP_MAX)) &&
-                        ((neighbor.pose.y >= 0) && (neighbor.pose.y < MAP_MAX)))) {
-                    continue;
-                }
+        // Planned once here, the workers only read it
+        bool corridor = false;
+#ifdef COARSE_CORRIDOR
+        corridor = coarse_grid.plan(bot, goal_region);
+#endif
 
-                if (!isWalkable(current, neighbor)) {
-                    continue;
-                }
+        SearchStatus status;
+        int winner = portfolio.plan(start, target, data_img, corridor, &status);
 
-                double tentative_g_dist_score = neighbor.g_dist + current.g_dist;
-                double dist_admissible = distance(neighbor.pose, goal.pose);
-                double dist_consistent = dist_admissible;
-
-                double vdt_neighbor = final.at<float>(MAP_MAX - 1 - neighbor.pose.y, neighbor.pose.x);
-                double vdt_goal = final.at<float>(MAP_MAX - 1 - goal.pose.y, goal.pose.x);
-                double obs_admissible = (vdt_neighbor + vdt_goal) / 2;
-                double obs_consistent = obs_admissible;
-                neighbor.g_obs = vdt_neighbor;
-                double tentative_g_obs_score = (neighbor.g_obs + current.g_obs * current.depth) / (current.depth + 1);
-                //                double tentative_g_obs_score = (neighbor.g_obs + current.g_obs) / 2;
-
-                if (!((open_map.find(neighbor.pose) != open_map.end()) &&
-                        (open_map[neighbor.pose].membership == OPEN))) {
-                    came_from[neighbor. pose] = current;
-                    neighbor.g_dist = tentative_g_dist_score;
-                    neighbor.h_dist = dist_consistent;
-
-                    //                    neighbor.g_obs = tentative_g_obs_score;
-                    neighbor.h_obs = obs_consistent;
-                    double scaling_factor = 1 * neighbor.h_dist / (2 * vdt_max + vdt_goal);
-                    //double scaling_factor = 1;
-                    neighbor.g_obs *= scaling_factor;
-                    neighbor.h_obs *= scaling_factor;
-                    neighbor.depth = current.depth + 1;
-
-                    //next condition is always true
-                    if (!((open_map.find(neighbor.pose) != open_map.end()) &&
-                            (open_map[neighbor.pose].membership == OPEN))) {
-                        open_list.push_back(neighbor);
-                        push_heap(open_list.begin(), open_list.end(), StateCompareDT());
-                        open_map[neighbor.pose].membership = OPEN;
-                        open_map[neighbor.pose].cost = neighbor.g_dist;
-                    }
-                }
-            }
+        if (winner == -1) {
+            search_stats.expansions = 0;
+            search_stats.peak_open = 0;
+            search_stats.path_cost = -1;
+            search_stats.collision_checks = 0;
 
-            iterations++;
-            if (iterations > MAX_ITER) {
-                ROS_WARN("[PLANNER] DT Open List Overflow - RETRYING w/o DT");
-                ol_overflow = 1;
+            if (status == SearchOverflow) {
+                ROS_WARN("[PLANNER] No portfolio path within the deadline");
                 Planner::finBot();
                 return cmdvel;
             }
+            return searchCommand(status, -1, data_img);
         }
 
-        ROS_ERROR("[PLANNER] No Path Found");
-        closePlanner();
-        cmdvel = kTurn();
+        const portfolio_worker& w = portfolio.worker(winner);
+        search_stats = w.workspace.stats;
+        return searchCommand(status, w.goal_node, data_img, w.workspace);
+    }
 
-        return cmdvel;
+    geometry_msgs::Twist Planner::findPathDynamic(Triplet bot, Triplet target, Mat data_img) {
+        data_img = drawableMap(data_img);
+        state start;
+        start.pose = bot;
+        goal_region.set(target);
+
+        geometry_msgs::Twist cmdvel;
+        brake.vl = brake.vr = 0;
+
+        if (isEqual(start, goal_region)) {
+            ROS_INFO("[PLANNER] Target Reached");
+            Planner::finBot();
+            return cmdvel;
+        }
+
+        // No path reuse or coarse corridor: both only know the static map
+
+        int goal_node;
+        LatticeHeuristic h(target);
+        DynamicSearch search(main_workspace, LengthCost(), h, LatticeSuccessors(), DynamicCollision());
+        SearchStatus status = search.run(start, data_img, &goal_node);
+
+        // The lattice has no waiting, an obstacle crossing right ahead blocks every seed; plan around where it is now
+        if (status == SearchNoPath && obstacle_prediction.size() > 0) {
+            PlainSearch static_search(main_workspace, LengthCost(), h, LatticeSuccessors(), LatticeCollision());
+            status = static_search.run(start, data_img, &goal_node);
+        }
+
+        if (status == SearchOverflow) {
+            ROS_WARN("[PLANNER] Open List Overflow");
+            Planner::finBot();
+            return cmdvel;
+        }
+
+        return searchCommand(status, goal_node, data_img);
     }
 
-    void Planner::finBot() {
-        sendCommand(brake);
+    bool Planner::tracksPath() {
+        return PID_MODE == 3;
+    }
+
+    bool Planner::trackPath(TripletFP motion, geometry_msgs::Twist *cmdvel) {
+        int left_vel, right_vel;
+
+        path_tracker.move(motion);
+        bool following = path_tracker.command(&left_vel, &right_vel);
+        *cmdvel = wheelCommand(left_vel, right_vel);
+
+        return following;
+    }
+
+    planner_stats Planner::lastStats() {
+        return search_stats;
     }
 }
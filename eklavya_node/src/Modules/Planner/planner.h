@@ -12,11 +12,22 @@
 #include <highgui.h>
 #include <iostream>
 #include <time.h>
+#include <vector>
 //using namespace cv;
 //#define MATDATA(img,x,y,n) img.at<cv::Vec3b>(x,y)[n]
 #define LEFT_CMD 0
 #define RIGHT_CMD 1
 
+enum PlannerModes {
+    PlainAStar = 0,
+    DistTransformAStar = 1,
+    IncrementalAStar = 2,
+    AnytimeAStar = 3,
+    HybridAStar = 4,
+    PortfolioAStar = 5,
+    DynamicAStar = 6
+};
+
 extern char** local_map;
 extern cv::Mat map_img;
 extern int ol_overflow;
@@ -29,6 +40,33 @@ namespace planner_space {
         int left_velocity, right_velocity;
     } command;
 
+    typedef struct state { // elemental data structure of openset
+        Triplet pose;
+        double g_dist, h_dist; // costs
+        int seed_id;
+        double g_obs, h_obs;
+        int depth;
+    } state;
+
+    typedef struct seed_point {
+        double x, y;
+    } seed_point;
+
+    typedef struct seed {
+        Triplet dest;
+        double cost;
+        double k; // velocity ratio
+        double vl, vr; // individual velocities
+        vector<seed_point> seed_points;
+    } seed;
+
+    typedef struct planner_stats { // counters of the last findPath* call
+        int expansions;
+        int peak_open; // largest open list seen
+        double path_cost; // -1 if no path was found
+        int collision_checks; // isWalkable calls
+    } planner_stats;
+
     class Planner {
     public:
         //        static  ros::NodeHandle nh;
@@ -37,9 +75,22 @@ namespace planner_space {
         //     static ros::Publisher vel_pub;
 
         static void loadPlanner();
+        static bool buildHeuristicTable(const char *seeds_file = NULL, const char *table_file = NULL); // NULL for SEEDS_FILE, HEURISTIC_FILE; see heuristic_generator
+        static void updateCostField(cv::Mat map_img);
+        static void updateOccupancy();
+        static void updateObstacles(const vector<Obstacle>& tracked, double now); // after updateOccupancy(), for findPathDynamic; now is wall time
+        static void updateEgoMotion(TripletFP motion, double now); // of the bot since the last cycle up to now (wall time), see EgoMotion
+        static bool tracksPath(); // PID_MODE 3, commands come from tracker_thread
+        static bool trackPath(TripletFP motion, geometry_msgs::Twist *cmdvel); // one tracker cycle, false if no path is followed
         static geometry_msgs::Twist findPath(Triplet bot, Triplet target, cv::Mat map_img);
         static geometry_msgs::Twist findPathDT(Triplet bot, Triplet target, cv::Mat map_img);
+        static geometry_msgs::Twist findPathIncremental(Triplet bot, Triplet target, cv::Mat map_img);
+        static geometry_msgs::Twist findPathAnytime(Triplet bot, Triplet target, cv::Mat map_img);
+        static geometry_msgs::Twist findPathHybrid(Triplet bot, Triplet target, cv::Mat map_img);
+        static geometry_msgs::Twist findPathPortfolio(Triplet bot, Triplet target, cv::Mat map_img);
+        static geometry_msgs::Twist findPathDynamic(Triplet bot, Triplet target, cv::Mat map_img);
         static void finBot();
+        static planner_stats lastStats();
     };
 }
 
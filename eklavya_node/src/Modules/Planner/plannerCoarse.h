@@ -0,0 +1,184 @@
+#ifndef _PLANNER_COARSE_H_
+#define _PLANNER_COARSE_H_
+
+#include <math.h>
+#include <vector>
+#include "plannerOccupancy.h"
+#include "plannerGoal.h"
+#include "plannerHeap.h"
+
+/**
+ * Coarse planning level: COARSE_RES x COARSE_RES map cells per coarse cell.
+ * The lattice search is confined to CORRIDOR_RADIUS coarse cells around the
+ * coarse path.
+ */
+#define COARSE_RES 10
+#define COARSE_SIZE ((MAP_MAX + COARSE_RES - 1) / COARSE_RES)
+#define CORRIDOR_RADIUS 5
+
+// Octile over euclidean distance at worst, and the offset of a pose within its cell at either end,
+// taken off the coarse path length in costEstimate()
+#define COARSE_OCTILE_FACTOR 1.0824
+#define COARSE_SLACK (2 * COARSE_RES)
+
+namespace planner_space {
+
+    /**
+     * Max-pooled occupancy: a coarse cell is blocked if any of its map cells
+     * is, so the coarse level never passes where the bot can not. Gaps
+     * narrower than a coarse cell may close; the caller then searches the
+     * full map.
+     *
+     * plan() runs A* from the goal region towards the bot over the free
+     * coarse cells. It settles about as many cells as the path is long, so
+     * its cost does not grow with the map area.
+     */
+    class CoarseGrid {
+    public:
+
+        CoarseGrid() : generation(0) {
+            memset(blocked, 0, sizeof (blocked));
+            g.resize(COARSE_SIZE * COARSE_SIZE);
+            parent.resize(COARSE_SIZE * COARSE_SIZE);
+            seen.assign(COARSE_SIZE * COARSE_SIZE, 0);
+            closed.assign(COARSE_SIZE * COARSE_SIZE, 0);
+            corridor.assign(COARSE_SIZE * COARSE_SIZE, 0);
+        }
+
+        void pool(const OccupancyGrid& occupancy) {
+            const uint64_t mask = ((uint64_t) 1 << COARSE_RES) - 1;
+
+            for (int cx = 0; cx < COARSE_SIZE; cx++) {
+                int x_end = min((cx + 1) * COARSE_RES, MAP_MAX);
+                for (int cy = 0; cy < COARSE_SIZE; cy++) {
+                    uint64_t cells = 0;
+                    for (int x = cx * COARSE_RES; x < x_end && !cells; x++) {
+                        cells = occupancy.window(x, cy * COARSE_RES) & mask;
+                    }
+                    blocked[cx][cy] = cells != 0;
+                }
+            }
+        }
+
+        /// Coarse path from bot to goal and its corridor, false if the coarse grid has none
+        bool plan(Triplet bot, const GoalRegion& goal) {
+            generation++;
+            open.clear();
+
+            int bx = bot.x / COARSE_RES, by = bot.y / COARSE_RES;
+            Triplet center = goal.center();
+
+            // Every free cell that may hold a goal cell
+            double reach = GOAL_RADIUS + COARSE_RES * 0.71;
+            int r = (int) ceil(reach / COARSE_RES);
+            int gx = center.x / COARSE_RES, gy = center.y / COARSE_RES;
+            for (int cx = max(0, gx - r); cx <= min(COARSE_SIZE - 1, gx + r); cx++) {
+                for (int cy = max(0, gy - r); cy <= min(COARSE_SIZE - 1, gy + r); cy++) {
+                    double dx = (cx + 0.5) * COARSE_RES - center.x;
+                    double dy = (cy + 0.5) * COARSE_RES - center.y;
+                    if (dx * dx + dy * dy <= reach * reach && !blocked[cx][cy]) {
+                        int c = cell(cx, cy);
+                        seen[c] = generation;
+                        g[c] = 0;
+                        parent[c] = -1;
+                        open.push(c, distance(cx, cy, bx, by));
+                    }
+                }
+            }
+
+            while (!open.empty()) {
+                int c = open.pop();
+                closed[c] = generation;
+                int cx = c / COARSE_SIZE, cy = c % COARSE_SIZE;
+
+                if (cx == bx && cy == by) {
+                    markCorridor(c);
+                    return true;
+                }
+
+                for (int dx = -1; dx <= 1; dx++) {
+                    for (int dy = -1; dy <= 1; dy++) {
+                        int nx = cx + dx, ny = cy + dy;
+                        if ((dx == 0 && dy == 0) || nx < 0 || nx >= COARSE_SIZE || ny < 0 || ny >= COARSE_SIZE) {
+                            continue;
+                        }
+                        // The bot's own cell may be pooled with an obstacle next to it
+                        if (blocked[nx][ny] && !(nx == bx && ny == by)) {
+                            continue;
+                        }
+
+                        int n = cell(nx, ny);
+                        if (closed[n] == generation) {
+                            continue;
+                        }
+
+                        double step = (dx != 0 && dy != 0) ? COARSE_RES * M_SQRT2 : COARSE_RES;
+                        if (seen[n] != generation) {
+                            seen[n] = generation;
+                            g[n] = g[c] + step;
+                            parent[n] = c;
+                            open.push(n, g[n] + distance(nx, ny, bx, by));
+                        } else if (g[c] + step < g[n]) {
+                            g[n] = g[c] + step;
+                            parent[n] = c;
+                            open.update(n, g[n] + distance(nx, ny, bx, by));
+                        }
+                    }
+                }
+            }
+
+            return false;
+        }
+
+        bool inCorridor(int x, int y) const {
+            return corridor[cell(x / COARSE_RES, y / COARSE_RES)] == generation;
+        }
+
+        /**
+         * Path length from (x, y) to the goal of the last plan() along the
+         * coarse path, 0 if unknown. Not a lower bound: where max-pooling
+         * closes a gap the bot fits through, the coarse path detours, so
+         * searches guided by it are not optimal (the corridor confines them
+         * anyway).
+         */
+        double costEstimate(int x, int y) const {
+            int c = cell(x / COARSE_RES, y / COARSE_RES);
+            if (closed[c] != generation) {
+                return 0;
+            }
+            return max(0.0, g[c] / COARSE_OCTILE_FACTOR - COARSE_SLACK);
+        }
+
+    private:
+
+        static int cell(int cx, int cy) {
+            return cx * COARSE_SIZE + cy;
+        }
+
+        static double distance(int ax, int ay, int bx, int by) {
+            return COARSE_RES * sqrt((double) ((ax - bx) * (ax - bx) + (ay - by) * (ay - by)));
+        }
+
+        /// Cells within CORRIDOR_RADIUS of the path from c back to the goal
+        void markCorridor(int c) {
+            for (; c != -1; c = parent[c]) {
+                int cx = c / COARSE_SIZE, cy = c % COARSE_SIZE;
+                for (int x = max(0, cx - CORRIDOR_RADIUS); x <= min(COARSE_SIZE - 1, cx + CORRIDOR_RADIUS); x++) {
+                    for (int y = max(0, cy - CORRIDOR_RADIUS); y <= min(COARSE_SIZE - 1, cy + CORRIDOR_RADIUS); y++) {
+                        corridor[cell(x, y)] = generation;
+                    }
+                }
+            }
+        }
+
+        unsigned char blocked[COARSE_SIZE][COARSE_SIZE];
+        std::vector<float> g;
+        std::vector<int> parent;
+        // Stamped with the generation of the plan() that set them, nothing is cleared per plan
+        std::vector<unsigned int> seen, closed, corridor;
+        unsigned int generation;
+        IndexedHeap<double> open;
+    };
+}
+
+#endif
@@ -0,0 +1,274 @@
+#ifndef _PLANNER_COST_FIELD_H_
+#define _PLANNER_COST_FIELD_H_
+
+#include <string.h>
+#include "planner.h"
+
+#define DT_THRESH 100 // distances are clamped here
+#define VORONOI_BORDER 10 // virtual walls drawn at these columns from each side
+#define FIELD_FRAME 20 // width of the free frame around the ridge map
+#define FIELD_TILE 50 // change detection granularity, in pixels
+#define FIELD_FULL_FRACTION 0.6 // dirty areas larger than this share of the map are rebuilt whole
+
+namespace planner_space {
+
+    /**
+     * Voronoi/distance transform cost field used by findPathDT.
+     *
+     * Built from the planner map (image frame) once per map update, then only
+     * read by the search. When few tiles of the map change, each stage is
+     * recomputed over the dirty area grown by that stage's reach. The result
+     * is the same as a full rebuild, unless the update moves one of the global
+     * min/max values used to normalize the field; then it is rebuilt whole.
+     * The reach of the last stage (distance to the ridges) is only bounded
+     * while no cell lies farther than its halo from a ridge; in maps cluttered
+     * enough for that, the stage runs over the whole map.
+     */
+    class CostField {
+    public:
+
+        CostField() : valid(false) {
+        }
+
+        bool ready() const {
+            return valid;
+        }
+
+        /// Cost at map cell (x, y)
+        float at(int x, int y) const {
+            return field.at<float>(MAP_MAX - 1 - y, x);
+        }
+
+        /// Largest clamped obstacle distance in the map
+        float maxDistance() const {
+            return dist_max;
+        }
+
+        void update(const cv::Mat& map_img) {
+            if (!valid) {
+                map_img.copyTo(input);
+                rebuild();
+                return;
+            }
+
+            cv::Rect dirty;
+            if (!diff(map_img, &dirty)) {
+                return;
+            }
+
+            cv::Mat changed = input(dirty);
+            map_img(dirty).copyTo(changed);
+
+            cv::Rect a1 = grow(dirty, DT_THRESH + 2);
+            cv::Rect in1 = grow(a1, DT_THRESH + 2);
+            if (in1.area() > FIELD_FULL_FRACTION * MAP_MAX * MAP_MAX) {
+                rebuild();
+                return;
+            }
+
+            computeFree(dirty);
+
+            // Obstacle distance, clamped so DT_THRESH bounds how far a change reaches
+            cv::Mat old_dist = dist(a1).clone();
+            computeDistance(a1, in1);
+            if (extremaMoved(old_dist, dist(a1), dist_min, dist_max)) {
+                rebuild();
+                return;
+            }
+
+            // Blur and Laplacian reach 2 pixels
+            cv::Rect a2 = grow(a1, 2);
+            cv::Rect in2 = grow(a2, 2);
+            cv::Mat old_lap = lap(a2).clone();
+            computeLaplacian(a2, in2);
+            if (extremaMoved(old_lap, lap(a2), lap_min, lap_max)) {
+                rebuild();
+                return;
+            }
+
+            computeRidges(a2);
+
+            // Ridge distances usually stay below the ridge band width plus the frame
+            const int reach = DT_THRESH + FIELD_FRAME + 2;
+            if (field_max <= reach) {
+                cv::Rect a3 = grow(a2, reach);
+                cv::Rect in3 = grow(a3, reach);
+                computeField(a3, in3);
+
+                double min_val, max_val;
+                cv::minMaxLoc(field(a3), &min_val, &max_val);
+                if (max_val <= reach) {
+                    // Cells outside a3 kept their values, so this stays an upper bound
+                    field_max = max(field_max, max_val);
+                    return;
+                }
+            }
+
+            computeWholeField();
+        }
+
+    private:
+
+        void rebuild() {
+            cv::Rect all(0, 0, MAP_MAX, MAP_MAX);
+
+            if (free_map.empty()) {
+                free_map.create(MAP_MAX, MAP_MAX, CV_8UC1);
+                dist.create(MAP_MAX, MAP_MAX, CV_32FC1);
+                lap.create(MAP_MAX, MAP_MAX, CV_32FC1);
+                ridges.create(MAP_MAX, MAP_MAX, CV_8UC1);
+                field.create(MAP_MAX, MAP_MAX, CV_32FC1);
+            }
+
+            computeFree(all);
+
+            computeDistance(all, all);
+            double min_val, max_val;
+            cv::minMaxLoc(dist, &min_val, &max_val);
+            dist_min = min_val;
+            dist_max = max_val;
+
+            computeLaplacian(all, all);
+            cv::minMaxLoc(lap, &min_val, &max_val);
+            lap_min = min_val;
+            lap_max = max_val;
+
+            computeRidges(all);
+            computeWholeField();
+
+            valid = true;
+        }
+
+        void computeWholeField() {
+            cv::Rect all(0, 0, MAP_MAX, MAP_MAX);
+            computeField(all, all);
+
+            double min_val, max_val;
+            cv::minMaxLoc(field, &min_val, &max_val);
+            field_max = max_val;
+        }
+
+        /// Bounding box of the tiles that differ from the cached input, false if none
+        bool diff(const cv::Mat& map_img, cv::Rect *dirty) {
+            int x0 = MAP_MAX, y0 = MAP_MAX, x1 = -1, y1 = -1;
+
+            for (int ty = 0; ty < MAP_MAX; ty += FIELD_TILE) {
+                for (int tx = 0; tx < MAP_MAX; tx += FIELD_TILE) {
+                    int w = min(FIELD_TILE, MAP_MAX - tx);
+                    int h = min(FIELD_TILE, MAP_MAX - ty);
+
+                    bool changed = false;
+                    for (int i = ty; i < ty + h && !changed; i++) {
+                        changed = memcmp(map_img.ptr<uchar>(i) + tx, input.ptr<uchar>(i) + tx, w) != 0;
+                    }
+
+                    if (changed) {
+                        x0 = min(x0, tx);
+                        y0 = min(y0, ty);
+                        x1 = max(x1, tx + w);
+                        y1 = max(y1, ty + h);
+                    }
+                }
+            }
+
+            if (x1 == -1) {
+                return false;
+            }
+
+            *dirty = cv::Rect(x0, y0, x1 - x0, y1 - y0);
+            return true;
+        }
+
+        static cv::Rect grow(cv::Rect r, int margin) {
+            return cv::Rect(r.x - margin, r.y - margin, r.width + 2 * margin, r.height + 2 * margin) &
+                    cv::Rect(0, 0, MAP_MAX, MAP_MAX);
+        }
+
+        /// True if the new values may have moved the cached global extrema
+        static bool extremaMoved(const cv::Mat& old_values, const cv::Mat& new_values, double lo, double hi) {
+            double old_min, old_max, new_min, new_max;
+            cv::minMaxLoc(old_values, &old_min, &old_max);
+            cv::minMaxLoc(new_values, &new_min, &new_max);
+
+            return new_min < lo || new_max > hi ||
+                    (old_min == lo && new_min > lo) || (old_max == hi && new_max < hi);
+        }
+
+        /// Free space mask: map obstacles and the virtual Voronoi walls are 0
+        void computeFree(cv::Rect r) {
+            cv::Mat out = free_map(r);
+            cv::threshold(input(r), out, 126, 255, cv::THRESH_BINARY_INV);
+
+            int walls[2] = {VORONOI_BORDER, MAP_MAX - VORONOI_BORDER};
+            for (int k = 0; k < 2; k++) {
+                cv::Rect wall = cv::Rect(walls[k], VORONOI_BORDER, 1, MAP_MAX - 2 * VORONOI_BORDER + 1) & r;
+                if (wall.area() > 0) {
+                    free_map(wall).setTo(cv::Scalar(0));
+                }
+            }
+        }
+
+        void computeDistance(cv::Rect out, cv::Rect in) {
+            cv::Mat d;
+            cv::distanceTransform(free_map(in), d, CV_DIST_L2, 5);
+            cv::min(d, (double) DT_THRESH, d);
+
+            cv::Rect inner(out.x - in.x, out.y - in.y, out.width, out.height);
+            cv::Mat target = dist(out);
+            d(inner).copyTo(target);
+        }
+
+        void computeLaplacian(cv::Rect out, cv::Rect in) {
+            cv::Mat n, l;
+            double range = dist_max - dist_min;
+            dist(in).convertTo(n, CV_32F, range > 0 ? 1.0 / range : 0, range > 0 ? -dist_min / range : 0);
+            cv::GaussianBlur(n, n, cvSize(3, 3), 3);
+            cv::Laplacian(n, l, CV_32F, 1, 1, 0, cv::BORDER_DEFAULT);
+
+            cv::Rect inner(out.x - in.x, out.y - in.y, out.width, out.height);
+            cv::Mat target = lap(out);
+            l(inner).copyTo(target);
+        }
+
+        /// Band between the obstacles and the clamp distance, plus the free frame
+        void computeRidges(cv::Rect r) {
+            cv::Mat norm_image, saturated;
+            double range = lap_max - lap_min;
+            dist(r).convertTo(norm_image, CV_8U, 255.0 / range, -lap_min * 255.0 / range);
+            cv::compare(dist(r), (double) DT_THRESH, saturated, cv::CMP_GE);
+            norm_image.setTo(cv::Scalar(0), saturated);
+
+            cv::Mat out = ridges(r);
+            cv::threshold(norm_image, out, 90, 255, cv::THRESH_BINARY);
+
+            cv::Rect frame[4] = {
+                cv::Rect(0, 0, MAP_MAX, FIELD_FRAME),
+                cv::Rect(0, MAP_MAX - FIELD_FRAME + 1, MAP_MAX, FIELD_FRAME - 1),
+                cv::Rect(0, 0, FIELD_FRAME, MAP_MAX),
+                cv::Rect(MAP_MAX - FIELD_FRAME + 1, 0, FIELD_FRAME - 1, MAP_MAX)
+            };
+            for (int k = 0; k < 4; k++) {
+                cv::Rect f = frame[k] & r;
+                if (f.area() > 0) {
+                    ridges(f).setTo(cv::Scalar(255));
+                }
+            }
+        }
+
+        void computeField(cv::Rect out, cv::Rect in) {
+            cv::Mat d;
+            cv::distanceTransform(ridges(in), d, CV_DIST_L2, 3);
+
+            cv::Rect inner(out.x - in.x, out.y - in.y, out.width, out.height);
+            cv::Mat target = field(out);
+            d(inner).copyTo(target);
+        }
+
+        bool valid;
+        cv::Mat input, free_map, dist, lap, ridges, field;
+        double dist_min, dist_max, lap_min, lap_max;
+        double field_max; // upper bound on field, exact after a whole map pass
+    };
+}
+
+#endif
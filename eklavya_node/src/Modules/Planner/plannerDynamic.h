@@ -0,0 +1,159 @@
+#ifndef _PLANNER_DYNAMIC_H_
+#define _PLANNER_DYNAMIC_H_
+
+#include <math.h>
+#include <vector>
+#include <deque>
+#include "plannerOccupancy.h"
+#include "plannerSeedTable.h"
+
+/**
+ * Time-aware collision checks (findPathDynamic): tracked obstacles (see
+ * LidarData) faster than DYNAMIC_MIN_SPEED are taken off the static map and
+ * checked where they will be while the bot drives each seed. The bot covers
+ * seed cost at DYNAMIC_BOT_SPEED; obstacles keep their velocity for
+ * DYNAMIC_HORIZON seconds and are assumed to stand still after that.
+ */
+#define DYNAMIC_MIN_SPEED 20 // cells per second
+#define DYNAMIC_BOT_SPEED 50 // cells per second, the tracker's mean wheel velocity
+#define DYNAMIC_HORIZON 3.0 // seconds
+#define DYNAMIC_HISTORY 2.0 // seconds of bot motion kept to bring scans up to planning time
+#define DYNAMIC_BOT_X 500 // bot cell of the robot-centric map, as in LidarData
+#define DYNAMIC_BOT_Y 100
+
+namespace planner_space {
+
+    typedef struct predicted_obstacle {
+        double x, y; // at planning time
+        double vx, vy;
+        double radius;
+    } predicted_obstacle;
+
+    typedef struct timed_motion {
+        double begin, end; // wall time, seconds, like EgoMotion
+        TripletFP motion; // of the bot between begin and end, see EgoMotion
+    } timed_motion;
+
+    class ObstaclePrediction {
+    public:
+
+        ObstaclePrediction() : last_move(-1) {
+            moving.reserve(32);
+        }
+
+        /// The bot moved by motion (see EgoMotion) up to now (wall time, seconds)
+        void move(TripletFP motion, double now) {
+            if (last_move >= 0 && now > last_move) {
+                timed_motion m = {last_move, now, motion};
+                history.push_back(m);
+            }
+            last_move = now;
+
+            while (!history.empty() && history.front().end < now - DYNAMIC_HISTORY) {
+                history.pop_front();
+            }
+        }
+
+        /**
+         * Keeps the moving obstacles of tracked, moved on to now (wall time,
+         * seconds). Obstacles are in the bot frame of their scan, the bot's
+         * motion since then (see move()) brings them into the current one.
+         */
+        void update(const vector<Obstacle>& tracked, double now) {
+            moving.clear();
+
+            for (unsigned int i = 0; i < tracked.size(); i++) {
+                const Obstacle& o = tracked[i];
+                if (o.vx * o.vx + o.vy * o.vy < DYNAMIC_MIN_SPEED * DYNAMIC_MIN_SPEED) {
+                    continue;
+                }
+
+                double age = min(DYNAMIC_HORIZON, max(0.0, now - o.stamp));
+                predicted_obstacle p;
+                p.x = o.x + o.vx * age;
+                p.y = o.y + o.vy * age;
+                p.vx = o.vx;
+                p.vy = o.vy;
+                p.radius = o.radius;
+                toCurrentFrame(p, o.stamp);
+                moving.push_back(p);
+            }
+        }
+
+        /// Frees the cells the moving obstacles cover now, their prediction replaces them
+        void clearCurrent(OccupancyGrid& grid) const {
+            for (unsigned int i = 0; i < moving.size(); i++) {
+                grid.clearDisk((int) moving[i].x, (int) moving[i].y, (int) ceil(moving[i].radius));
+            }
+        }
+
+        /**
+         * Does an obstacle come within its radius of a swept cell of the seed
+         * e from (x, y), driven between times t0 and t1 from now.
+         */
+        bool blocks(const SeedTable& table, const seed_entry& e, int x, int y, double t0, double t1) const {
+            t0 = min(t0, DYNAMIC_HORIZON);
+            t1 = min(t1, DYNAMIC_HORIZON);
+
+            for (unsigned int i = 0; i < moving.size(); i++) {
+                const predicted_obstacle& o = moving[i];
+                double ax = o.x + o.vx * t0, ay = o.y + o.vy * t0;
+                double bx = o.x + o.vx * t1, by = o.y + o.vy * t1;
+                double r = o.radius;
+
+                // The obstacle's sweep over [t0, t1] against the seed's box
+                if (max(ax, bx) + r < x + e.lo.x || min(ax, bx) - r > x + e.hi.x ||
+                        max(ay, by) + r < y + e.lo.y || min(ay, by) - r > y + e.hi.y) {
+                    continue;
+                }
+
+                double dx = bx - ax, dy = by - ay;
+                double len2 = dx * dx + dy * dy;
+                for (int k = e.swept_begin; k < e.swept_end; k++) {
+                    const cell_offset& c = table.sweptCell(k);
+                    double px = x + c.x - ax, py = y + c.y - ay;
+                    double u = len2 > 0 ? min(1.0, max(0.0, (px * dx + py * dy) / len2)) : 0;
+                    double ex = px - u * dx, ey = py - u * dy;
+                    if (ex * ex + ey * ey < r * r) {
+                        return true;
+                    }
+                }
+            }
+
+            return false;
+        }
+
+        int size() const {
+            return moving.size();
+        }
+
+    private:
+
+        /// Moves p from the bot frame at time stamp to the current one, about the bot
+        void toCurrentFrame(predicted_obstacle& p, double stamp) const {
+            for (deque<timed_motion>::const_iterator it = history.begin(); it != history.end(); ++it) {
+                if (it->end <= stamp) {
+                    continue;
+                }
+
+                // Only the part of the interval after the scan, at the interval's mean rate
+                double k = (it->end - max(it->begin, stamp)) / (it->end - it->begin);
+                double a = -k * it->motion.z * CV_PI / 180;
+                double dx = p.x - DYNAMIC_BOT_X - k * it->motion.x;
+                double dy = p.y - DYNAMIC_BOT_Y - k * it->motion.y;
+                p.x = DYNAMIC_BOT_X + dx * cos(a) - dy * sin(a);
+                p.y = DYNAMIC_BOT_Y + dx * sin(a) + dy * cos(a);
+
+                double vx = p.vx;
+                p.vx = vx * cos(a) - p.vy * sin(a);
+                p.vy = vx * sin(a) + p.vy * cos(a);
+            }
+        }
+
+        vector<predicted_obstacle> moving;
+        deque<timed_motion> history; // oldest first
+        double last_move; // time of the last move(), -1 before the first
+    };
+}
+
+#endif
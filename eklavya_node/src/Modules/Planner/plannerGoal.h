@@ -0,0 +1,92 @@
+#ifndef _PLANNER_GOAL_H_
+#define _PLANNER_GOAL_H_
+
+#include <stdint.h>
+#include <string.h>
+#include "../../eklavya2.h"
+
+/// The target is reached within this many cells (strictly less)
+#define GOAL_RADIUS 35
+
+#define GOAL_WIDTH (2 * GOAL_RADIUS + 1)
+// One spare word per row so a 64 cell window can always read two words
+#define GOAL_ROW_WORDS ((GOAL_WIDTH + 63) / 64 + 1)
+
+namespace planner_space {
+
+    /**
+     * Target tolerance disk as a bitmap, in the row layout of OccupancyGrid:
+     * row x holds cells (x, y) with y along the bits. The disk is rasterized
+     * once, a query only moves its origin. Cells may lie outside the map.
+     */
+    class GoalRegion {
+    public:
+
+        GoalRegion() : base_x(0), base_y(0) {
+            memset(rows, 0, sizeof (rows));
+            for (int dx = -GOAL_RADIUS; dx <= GOAL_RADIUS; dx++) {
+                for (int dy = -GOAL_RADIUS; dy <= GOAL_RADIUS; dy++) {
+                    if (dx * dx + dy * dy < GOAL_RADIUS * GOAL_RADIUS) {
+                        int b = dy + GOAL_RADIUS;
+                        rows[dx + GOAL_RADIUS][b / 64] |= (uint64_t) 1 << (b % 64);
+                    }
+                }
+            }
+        }
+
+        void set(Triplet goal) {
+            base_x = goal.x - GOAL_RADIUS;
+            base_y = goal.y - GOAL_RADIUS;
+        }
+
+        /// Cell the disk is centred on
+        Triplet center() const {
+            Triplet c;
+            c.x = base_x + GOAL_RADIUS;
+            c.y = base_y + GOAL_RADIUS;
+            c.z = 0;
+            return c;
+        }
+
+        bool contains(int x, int y) const {
+            int i = x - base_x;
+            int b = y - base_y;
+            if (i < 0 || i >= GOAL_WIDTH || b < 0 || b >= GOAL_WIDTH) {
+                return false;
+            }
+            return (rows[i][b / 64] >> (b % 64)) & 1;
+        }
+
+        /// Does the box [lo_x, hi_x] x [lo_y, hi_y] touch the bounding box of the disk
+        bool overlaps(int lo_x, int lo_y, int hi_x, int hi_y) const {
+            return hi_x >= base_x && lo_x < base_x + GOAL_WIDTH && hi_y >= base_y && lo_y < base_y + GOAL_WIDTH;
+        }
+
+        /// Cells (x, y) .. (x, y + 63) as bits 0..63, see OccupancyGrid::window()
+        uint64_t window(int x, int y) const {
+            int i = x - base_x;
+            int b = y - base_y;
+            if (i < 0 || i >= GOAL_WIDTH || b >= GOAL_WIDTH || b <= -64) {
+                return 0;
+            }
+
+            const uint64_t *row = rows[i];
+            if (b < 0) {
+                return row[0] << -b;
+            }
+
+            int w = b / 64;
+            int shift = b % 64;
+            if (shift == 0) {
+                return row[w];
+            }
+            return (row[w] >> shift) | (row[w + 1] << (64 - shift));
+        }
+
+    private:
+        uint64_t rows[GOAL_WIDTH][GOAL_ROW_WORDS];
+        int base_x, base_y;
+    };
+}
+
+#endif
@@ -0,0 +1,154 @@
+#ifndef _PLANNER_HEAP_H_
+#define _PLANNER_HEAP_H_
+
+#include <vector>
+#include <functional>
+
+/**
+ * Children per heap node. A 4-ary heap halves the depth of a binary one and
+ * keeps the children of a node on one cache line.
+ */
+#define PLANNER_HEAP_ARITY 4
+
+namespace planner_space {
+
+    /**
+     * Indexed d-ary min-heap over dense node ids, as handed out by the search
+     * node pools. Each node is queued at most once; its key is changed in place
+     * with update(), so the open lists never hold stale duplicates.
+     */
+    template <typename Key, typename Less = std::less<Key> >
+    class IndexedHeap {
+    public:
+
+        bool empty() const {
+            return entries.empty();
+        }
+
+        int size() const {
+            return entries.size();
+        }
+
+        void clear() {
+            for (unsigned int k = 0; k < entries.size(); k++) {
+                position[entries[k].node] = -1;
+            }
+            entries.clear();
+        }
+
+        bool contains(int node) const {
+            return node < (int) position.size() && position[node] != -1;
+        }
+
+        int top() const {
+            return entries[0].node;
+        }
+
+        const Key& topKey() const {
+            return entries[0].key;
+        }
+
+        /// node must not be queued already
+        void push(int node, const Key& key) {
+            if (node >= (int) position.size()) {
+                position.resize(node + 1, -1);
+            }
+
+            heap_entry e;
+            e.key = key;
+            e.node = node;
+            entries.push_back(e);
+            position[node] = entries.size() - 1;
+            siftUp(entries.size() - 1);
+        }
+
+        int pop() {
+            int node = entries[0].node;
+            remove(node);
+            return node;
+        }
+
+        /// Changes the key of a queued node, either direction
+        void update(int node, const Key& key) {
+            int k = position[node];
+            bool decrease = less(key, entries[k].key);
+            entries[k].key = key;
+
+            if (decrease) {
+                siftUp(k);
+            } else {
+                siftDown(k);
+            }
+        }
+
+        void remove(int node) {
+            int k = position[node];
+            heap_entry last = entries.back();
+            entries.pop_back();
+            position[node] = -1;
+
+            if (last.node != node) {
+                entries[k] = last;
+                position[last.node] = k;
+                siftUp(k);
+                siftDown(position[last.node]);
+            }
+        }
+
+    private:
+
+        typedef struct heap_entry {
+            Key key;
+            int node;
+        } heap_entry;
+
+        void siftUp(int k) {
+            heap_entry e = entries[k];
+            while (k > 0) {
+                int parent = (k - 1) / PLANNER_HEAP_ARITY;
+                if (!less(e.key, entries[parent].key)) {
+                    break;
+                }
+                entries[k] = entries[parent];
+                position[entries[k].node] = k;
+                k = parent;
+            }
+            entries[k] = e;
+            position[e.node] = k;
+        }
+
+        void siftDown(int k) {
+            int n = entries.size();
+            heap_entry e = entries[k];
+            while (true) {
+                int first = k * PLANNER_HEAP_ARITY + 1;
+                if (first >= n) {
+                    break;
+                }
+
+                int last = first + PLANNER_HEAP_ARITY < n ? first + PLANNER_HEAP_ARITY : n;
+                int smallest = first;
+                for (int c = first + 1; c < last; c++) {
+                    if (less(entries[c].key, entries[smallest].key)) {
+                        smallest = c;
+                    }
+                }
+
+                if (!less(entries[smallest].key, e.key)) {
+                    break;
+                }
+                entries[k] = entries[smallest];
+                position[entries[k].node] = k;
+                k = smallest;
+            }
+            entries[k] = e;
+            position[e.node] = k;
+        }
+
+        std::vector<heap_entry> entries;
+        std::vector<int> position; // index in entries per node id, -1 if not queued
+        Less less;
+    };
+}
+
+#endif
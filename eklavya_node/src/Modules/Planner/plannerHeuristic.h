@@ -0,0 +1,356 @@
+#ifndef _PLANNER_HEURISTIC_H_
+#define _PLANNER_HEURISTIC_H_
+
+#include <stdio.h>
+#include <float.h>
+#include <queue>
+#include "planner.h"
+#include "plannerSeedTable.h"
+#include "plannerGoal.h"
+
+/**
+ * Extent of the heuristic table: target offsets up to HEURISTIC_RANGE along
+ * either axis of the node frame, HEURISTIC_RES cells per entry. Farther
+ * targets fall back to the euclidean distance.
+ */
+#define HEURISTIC_RANGE 600
+#define HEURISTIC_RES 10
+#define HEURISTIC_SIZE (2 * HEURISTIC_RANGE / HEURISTIC_RES)
+
+/// Room around the table for the paths that leave it and come back while generating
+#define HEURISTIC_MARGIN 200
+
+/**
+ * The generating search runs on an abstraction of the lattice: positions
+ * merged into HEURISTIC_CELL sized cells and headings, relative to the start
+ * heading, into HEURISTIC_HEADING_BINS bins. A move from an abstract state
+ * reaches every cell any of its concrete states could reach, so its costs
+ * never exceed the lattice's.
+ */
+#define HEURISTIC_CELL 5
+#define HEURISTIC_HEADING_BINS 72
+
+/// Bound on the rounding of a seed offset or swept cell to the map grid, per axis of the node frame
+/// (< sqrt(2), with SEED_TABLE_RES 1 the rotation itself is exact)
+#define HEURISTIC_SLACK 1.5
+
+#define HEURISTIC_MAGIC 0x48545555
+
+namespace planner_space {
+
+    typedef struct heuristic_header {
+        int magic;
+        int range, res;
+        int n_seeds;
+        double fingerprint; // of the seed set the table was generated from
+    } heuristic_header;
+
+    typedef struct heuristic_entry { // generator open list entry
+        float g;
+        int x, y, bin; // abstract cell and relative heading bin
+
+        bool operator>(const heuristic_entry& other) const {
+            return g > other.g;
+        }
+    } heuristic_entry;
+
+    typedef struct heuristic_move { // a seed from any heading of one bin, in abstract cells
+        int lo_x, lo_y, hi_x, hi_y;
+        int bin;
+        float cost;
+    } heuristic_move;
+
+    /**
+     * Obstacle-free cost-to-go of the seed lattice. Entry (i, j) is a lower
+     * bound on the seed cost from a node to any target at offset
+     * (i, j) * HEURISTIC_RES - HEURISTIC_RANGE in the node's frame, which is
+     * the frame the seeds are defined in (heading 90, x lateral, y ahead).
+     * The bound holds for every node heading: the generator covers the
+     * rounding of the rotated seeds to the grid (HEURISTIC_SLACK) instead of
+     * searching from heading 90 only. The target heading is not part of the
+     * key since the goal test ignores it.
+     *
+     * The table is generated offline by heuristic_generator. It is only valid
+     * for the seed set it was built from, load() refuses any other.
+     */
+    class HeuristicTable {
+    public:
+
+        HeuristicTable() : loaded(false) {
+            for (int z = 0; z < 360; z++) {
+                sin_z[z] = sin(z * CV_PI / 180);
+                cos_z[z] = cos(z * CV_PI / 180);
+            }
+        }
+
+        bool ready() const {
+            return loaded;
+        }
+
+        /// Lower bound on the seed cost from pose to target, 0 if unknown
+        double cost(Triplet pose, Triplet target) const {
+            if (!loaded) {
+                return 0;
+            }
+
+            // Inverse of the SeedTable rotation
+            int z = ((pose.z % 360) + 360) % 360;
+            double wx = target.x - pose.x;
+            double wy = target.y - pose.y;
+            double sx = wx * sin_z[z] - wy * cos_z[z];
+            double sy = wx * cos_z[z] + wy * sin_z[z];
+
+            if (sx < -HEURISTIC_RANGE || sx >= HEURISTIC_RANGE || sy < -HEURISTIC_RANGE || sy >= HEURISTIC_RANGE) {
+                return 0;
+            }
+
+            int i = (int) ((sx + HEURISTIC_RANGE) / HEURISTIC_RES);
+            int j = (int) ((sy + HEURISTIC_RANGE) / HEURISTIC_RES);
+            return table[i * HEURISTIC_SIZE + j];
+        }
+
+        bool load(const char *file, const vector<seed>& seeds) {
+            loaded = false;
+
+            FILE *fp = fopen(file, "rb");
+            if (fp == NULL) {
+                return false;
+            }
+
+            heuristic_header header;
+            table.resize(HEURISTIC_SIZE * HEURISTIC_SIZE);
+            bool valid = fread(&header, sizeof (header), 1, fp) == 1 &&
+                    header.magic == HEURISTIC_MAGIC &&
+                    header.range == HEURISTIC_RANGE && header.res == HEURISTIC_RES &&
+                    header.n_seeds == (int) seeds.size() && header.fingerprint == fingerprint(seeds) &&
+                    fread(&table[0], sizeof (float), table.size(), fp) == table.size();
+            fclose(fp);
+
+            loaded = valid;
+            return valid;
+        }
+
+        bool save(const char *file, const vector<seed>& seeds) const {
+            FILE *fp = fopen(file, "wb");
+            if (fp == NULL) {
+                return false;
+            }
+
+            heuristic_header header;
+            header.magic = HEURISTIC_MAGIC;
+            header.range = HEURISTIC_RANGE;
+            header.res = HEURISTIC_RES;
+            header.n_seeds = seeds.size();
+            header.fingerprint = fingerprint(seeds);
+
+            bool written = fwrite(&header, sizeof (header), 1, fp) == 1 &&
+                    fwrite(&table[0], sizeof (float), table.size(), fp) == table.size();
+            fclose(fp);
+
+            return written;
+        }
+
+        /**
+         * Dijkstra over the abstract lattice from the origin. Each settled
+         * state reaches every target near its cell or near the cells its
+         * seeds may sweep (onTarget), so those entries get its cost; the
+         * result is then spread over the goal radius. A path leaving the
+         * generated area costs at least what the first such move did, which
+         * caps every entry.
+         */
+        void generate(const vector<seed>& seeds) {
+            const int half = (HEURISTIC_RANGE + HEURISTIC_MARGIN) / HEURISTIC_CELL;
+            const int width = 2 * half + 1;
+            const int cells = 2 * HEURISTIC_RANGE / HEURISTIC_CELL;
+            const int n_seeds = seeds.size();
+
+            vector<heuristic_move> moves;
+            vector<cell_offset> swept;
+            vector<int> move_begin, swept_begin;
+            buildMoves(seeds, moves, move_begin, swept, swept_begin);
+
+            vector<float> best(width * width * HEURISTIC_HEADING_BINS, FLT_MAX);
+            vector<float> reached(cells * cells, FLT_MAX);
+            float exit = FLT_MAX;
+            priority_queue<heuristic_entry, vector<heuristic_entry>, greater<heuristic_entry> > open;
+
+            heuristic_entry origin;
+            origin.g = 0;
+            origin.x = origin.y = 0;
+            origin.bin = 0;
+            best[stateKey(origin, half, width)] = 0;
+            open.push(origin);
+
+            while (!open.empty()) {
+                heuristic_entry current = open.top();
+                open.pop();
+                if (current.g > best[stateKey(current, half, width)]) {
+                    continue;
+                }
+
+                mark(reached, current.x, current.y, current.g);
+                int first = current.bin * n_seeds;
+                for (int k = swept_begin[first]; k < swept_begin[first + n_seeds]; k++) {
+                    mark(reached, current.x + swept[k].x, current.y + swept[k].y, current.g);
+                }
+
+                for (int m = move_begin[first]; m < move_begin[first + n_seeds]; m++) {
+                    const heuristic_move& mv = moves[m];
+
+                    heuristic_entry next;
+                    next.g = current.g + mv.cost;
+                    next.bin = mv.bin;
+                    for (next.x = current.x + mv.lo_x; next.x <= current.x + mv.hi_x; next.x++) {
+                        for (next.y = current.y + mv.lo_y; next.y <= current.y + mv.hi_y; next.y++) {
+                            if (abs(next.x) > half || abs(next.y) > half) {
+                                exit = min(exit, next.g);
+                                continue;
+                            }
+
+                            int key = stateKey(next, half, width);
+                            if (next.g < best[key]) {
+                                best[key] = next.g;
+                                open.push(next);
+                            }
+                        }
+                    }
+                }
+            }
+
+            // An entry is reached from any entry whose cells come within the goal radius of its own
+            const int per_entry = HEURISTIC_RES / HEURISTIC_CELL;
+            vector<float> coarse(HEURISTIC_SIZE * HEURISTIC_SIZE, FLT_MAX);
+            for (int x = 0; x < cells; x++) {
+                for (int y = 0; y < cells; y++) {
+                    float& c = coarse[(x / per_entry) * HEURISTIC_SIZE + y / per_entry];
+                    c = min(c, reached[x * cells + y]);
+                }
+            }
+
+            int reach = GOAL_RADIUS / HEURISTIC_RES + 1;
+            table.assign(HEURISTIC_SIZE * HEURISTIC_SIZE, 0);
+            for (int i = 0; i < HEURISTIC_SIZE; i++) {
+                for (int j = 0; j < HEURISTIC_SIZE; j++) {
+                    float h = exit;
+                    for (int di = -reach; di <= reach; di++) {
+                        for (int dj = -reach; dj <= reach; dj++) {
+                            int ni = i + di, nj = j + dj;
+                            if (ni < 0 || ni >= HEURISTIC_SIZE || nj < 0 || nj >= HEURISTIC_SIZE) {
+                                continue;
+                            }
+
+                            double gx = max(0, abs(di) - 1) * HEURISTIC_RES;
+                            double gy = max(0, abs(dj) - 1) * HEURISTIC_RES;
+                            if (gx * gx + gy * gy < GOAL_RADIUS * GOAL_RADIUS) {
+                                h = min(h, coarse[ni * HEURISTIC_SIZE + nj]);
+                            }
+                        }
+                    }
+
+                    // Entries nothing reaches stay 0, the euclidean distance takes over
+                    table[i * HEURISTIC_SIZE + j] = h == FLT_MAX ? 0 : h;
+                }
+            }
+
+            loaded = true;
+        }
+
+    private:
+
+        static int stateKey(const heuristic_entry& s, int half, int width) {
+            return ((s.x + half) * width + (s.y + half)) * HEURISTIC_HEADING_BINS + s.bin;
+        }
+
+        /// Abstract cells holding every grid cell within HEURISTIC_SLACK of p, seen from anywhere in the cell of the parent
+        static void cellRange(double px, double py, int& lo_x, int& lo_y, int& hi_x, int& hi_y) {
+            lo_x = (int) floor((px - HEURISTIC_SLACK) / HEURISTIC_CELL);
+            lo_y = (int) floor((py - HEURISTIC_SLACK) / HEURISTIC_CELL);
+            hi_x = (int) ceil((px + HEURISTIC_CELL + HEURISTIC_SLACK) / HEURISTIC_CELL) - 1;
+            hi_y = (int) ceil((py + HEURISTIC_CELL + HEURISTIC_SLACK) / HEURISTIC_CELL) - 1;
+        }
+
+        /**
+         * Moves and swept cells of every seed from every integral relative
+         * heading of each bin, rotated as SeedTable does. Entries of bin b,
+         * seed i start at index b * seeds.size() + i of the begin vectors.
+         */
+        static void buildMoves(const vector<seed>& seeds, vector<heuristic_move>& moves, vector<int>& move_begin,
+                vector<cell_offset>& swept, vector<int>& swept_begin) {
+            const int width = 360 / HEURISTIC_HEADING_BINS;
+
+            for (int b = 0; b < HEURISTIC_HEADING_BINS; b++) {
+                for (unsigned int i = 0; i < seeds.size(); i++) {
+                    move_begin.push_back(moves.size());
+                    swept_begin.push_back(swept.size());
+                    unsigned int first_swept = swept.size();
+
+                    for (int r = b * width; r < (b + 1) * width; r++) {
+                        double sin_r = sin(r * CV_PI / 180);
+                        double cos_r = cos(r * CV_PI / 180);
+
+                        heuristic_move mv;
+                        double dx = seeds[i].dest.x, dy = seeds[i].dest.y;
+                        cellRange(dx * cos_r - dy * sin_r, dx * sin_r + dy * cos_r, mv.lo_x, mv.lo_y, mv.hi_x, mv.hi_y);
+                        mv.bin = ((((r + seeds[i].dest.z - 90) % 360) + 360) % 360) / width;
+                        mv.cost = seeds[i].cost;
+                        moves.push_back(mv);
+
+                        for (unsigned int j = 0; j < seeds[i].seed_points.size(); j++) {
+                            // Seed points are truncated to cells before rotation, as in SeedTable
+                            int tx = seeds[i].seed_points[j].x;
+                            int ty = seeds[i].seed_points[j].y;
+
+                            int lo_x, lo_y, hi_x, hi_y;
+                            cellRange(tx * cos_r - ty * sin_r, tx * sin_r + ty * cos_r, lo_x, lo_y, hi_x, hi_y);
+                            for (int x = lo_x; x <= hi_x; x++) {
+                                for (int y = lo_y; y <= hi_y; y++) {
+                                    bool duplicate = false;
+                                    for (unsigned int k = first_swept; k < swept.size(); k++) {
+                                        if (swept[k].x == x && swept[k].y == y) {
+                                            duplicate = true;
+                                            break;
+                                        }
+                                    }
+
+                                    if (!duplicate) {
+                                        cell_offset c;
+                                        c.x = x;
+                                        c.y = y;
+                                        swept.push_back(c);
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+            move_begin.push_back(moves.size());
+            swept_begin.push_back(swept.size());
+        }
+
+        static void mark(vector<float>& reached, int x, int y, float g) {
+            const int half = HEURISTIC_RANGE / HEURISTIC_CELL;
+            if (x < -half || x >= half || y < -half || y >= half) {
+                return;
+            }
+
+            int k = (x + half) * (2 * half) + (y + half);
+            reached[k] = min(reached[k], g);
+        }
+
+        static double fingerprint(const vector<seed>& seeds) {
+            double f = 0;
+            for (unsigned int i = 0; i < seeds.size(); i++) {
+                const seed& s = seeds[i];
+                f += (i + 1) * (s.dest.x * 3.0 + s.dest.y * 5.0 + s.dest.z * 7.0 + s.cost * 11.0 + s.seed_points.size());
+            }
+            return f;
+        }
+
+        bool loaded;
+        vector<float> table;
+        double sin_z[360], cos_z[360];
+    };
+}
+
+#endif
@@ -0,0 +1,341 @@
+#ifndef _PLANNER_HYBRID_H_
+#define _PLANNER_HYBRID_H_
+
+#include "plannerMethods.h"
+
+/**
+ * Hybrid A*: the seeds are applied to continuous (x, y, theta) states, one
+ * state kept per lattice cell and heading bin, so poses no longer drift by
+ * the rounding of every step. Every HYBRID_SHOT_EVERY expansions, and on
+ * every expansion within HYBRID_SHOT_RANGE of the target, the search tries
+ * an analytic shot: a turn at the seeds' tightest radius followed by a
+ * straight line into the goal region (the shortest Dubins path to a point).
+ */
+#define HYBRID_SHOT_EVERY 10
+#define HYBRID_SHOT_RANGE 300
+#define HYBRID_SHOT_SLACK 1.25 // shots longer than this times the heuristic are detours, keep searching
+#define HYBRID_SHOT_STEP 2.0 // collision sampling along a shot, in cells
+#define HYBRID_PATH_STEP 25.0 // spacing of the shot poses added to the path
+#define HYBRID_HEADING_BINS 8 // states kept per cell, 45 degrees apart
+
+namespace planner_space {
+
+    enum HybridStatus {
+        HybridPathFound = 0,
+        HybridNoPath = 1,
+        HybridBudgetExceeded = 2
+    };
+
+    typedef struct hybrid_node {
+        double x, y, theta; // theta in degrees, as Triplet z
+        double g;
+        int parent, seed_id;
+        char membership;
+    } hybrid_node;
+
+    typedef struct dubins_shot { // turn by arc (radians, + is left) at radius, then straight
+        double arc, radius, straight;
+        double length; // up to the goal region
+    } dubins_shot;
+
+    class HybridPlanner {
+    public:
+
+        HybridPlanner() : allocated(false), turn_radius(0), shot_node(-1), expansions(0), peak_open(0) {
+        }
+
+        /// Searches from bot to goal_region, the path ends at goal_node (plus the shot, if any)
+        HybridStatus plan(Triplet bot, Triplet target, int *goal_node) {
+            if (!allocated) {
+                index.allocate();
+                turn_radius = tightestRadius();
+                allocated = true;
+            }
+
+            index.nextGeneration();
+            nodes.clear();
+            heap.clear();
+            shot_node = -1;
+            target_pose = target;
+
+            hybrid_node start;
+            start.x = bot.x;
+            start.y = bot.y;
+            start.theta = bot.z;
+            start.g = 0;
+            start.parent = -1;
+            start.seed_id = -1;
+            start.membership = OPEN;
+            nodes.push_back(start);
+            index.insert(LatticeIndex::key(bot, HYBRID_HEADING_BINS), 0);
+            heap.push(0, heuristic(bot, target));
+
+            expansions = 0;
+            peak_open = 1;
+            while (!heap.empty()) {
+                int n = heap.pop();
+                nodes[n].membership = CLOSED;
+                Triplet cell = pose(nodes[n]);
+
+                state s;
+                s.pose = cell;
+                if (isEqual(s, goal_region) || onTarget(s, goal_region)) {
+                    *goal_node = n;
+                    return HybridPathFound;
+                }
+
+                double h = heuristic(cell, target);
+                if ((expansions % HYBRID_SHOT_EVERY == 0 || h < HYBRID_SHOT_RANGE) && shoot(nodes[n], h * HYBRID_SHOT_SLACK, &shot)) {
+                    shot_node = n;
+                    *goal_node = n;
+                    return HybridPathFound;
+                }
+
+                expansions++;
+                if (expansions > MAX_ITER) {
+                    return HybridBudgetExceeded;
+                }
+
+                expand(n);
+                peak_open = max(peak_open, heap.size());
+            }
+
+            return HybridNoPath;
+        }
+
+        int expansionCount() const {
+            return expansions;
+        }
+
+        int peakOpen() const {
+            return peak_open;
+        }
+
+        double pathCost(int goal_node) const {
+            return nodes[goal_node].g + (goal_node == shot_node ? shot.length : 0);
+        }
+
+        /// Poses from the bot (excluded) to the target, returns the seed of the first step
+        int extractPath(int goal_node, vector<Triplet>& poses) {
+            int seed_id = -1;
+
+            poses.clear();
+            for (int n = goal_node; nodes[n].parent != -1; n = nodes[n].parent) {
+                poses.push_back(pose(nodes[n]));
+                seed_id = nodes[n].seed_id;
+            }
+            reverse(poses.begin(), poses.end());
+
+            if (goal_node == shot_node) {
+                for (double d = HYBRID_PATH_STEP; d < shot.length; d += HYBRID_PATH_STEP) {
+                    poses.push_back(shotPose(nodes[goal_node], shot, d));
+                }
+                poses.push_back(shotPose(nodes[goal_node], shot, shot.length));
+
+                if (seed_id == -1) {
+                    // Shot straight from the bot, follow it with the closest seed
+                    seed_id = closestSeed(nodes[goal_node], shot);
+                }
+            }
+
+            return seed_id;
+        }
+
+    private:
+
+        static Triplet pose(const hybrid_node& n) {
+            Triplet t;
+            t.x = (int) floor(n.x + 0.5);
+            t.y = (int) floor(n.y + 0.5);
+            t.z = (int) floor(n.theta + 0.5);
+            return t;
+        }
+
+        void expand(int parent) {
+            const hybrid_node p = nodes[parent];
+            state from;
+            from.pose = pose(p);
+            double a = p.theta * CV_PI / 180;
+            double sin_a = sin(a), cos_a = cos(a);
+
+            for (unsigned int i = 0; i < seeds.size(); i++) {
+                // Continuous form of the SeedTable rotation
+                hybrid_node next;
+                next.x = p.x + seeds[i].dest.x * sin_a + seeds[i].dest.y * cos_a;
+                next.y = p.y - seeds[i].dest.x * cos_a + seeds[i].dest.y * sin_a;
+                next.theta = fmod(p.theta + seeds[i].dest.z - 90 + 360, 360);
+                next.g = p.g + seeds[i].cost;
+                next.parent = parent;
+                next.seed_id = i;
+                next.membership = OPEN;
+
+                Triplet cell = pose(next);
+                if (!(((cell.x >= 0) && (cell.x < MAP_MAX)) && ((cell.y >= 0) && (cell.y < MAP_MAX)))) {
+                    continue;
+                }
+
+                // Swept cells of the seed at the parent's cell and nearest degree
+                state to;
+                to.seed_id = i;
+                if (!isWalkable(from, to)) {
+                    continue;
+                }
+
+                int key = LatticeIndex::key(cell, HYBRID_HEADING_BINS);
+                int n = index.find(key);
+                double f = next.g + heuristic(cell, target_pose);
+                if (n == -1) {
+                    nodes.push_back(next);
+                    index.insert(key, nodes.size() - 1);
+                    heap.push(nodes.size() - 1, f);
+                } else if ((nodes[n].membership == OPEN) && (next.g < nodes[n].g)) {
+                    nodes[n] = next;
+                    heap.update(n, f);
+                }
+            }
+        }
+
+        /// Shortest turn-then-straight path from n into the goal region that stays free, no longer than max_length
+        bool shoot(const hybrid_node& n, double max_length, dubins_shot *result) {
+            dubins_shot candidates[2];
+            int count = 0;
+            for (int side = -1; side <= 1; side += 2) {
+                if (dubinsToPoint(n, side, &candidates[count]) && candidates[count].length <= max_length) {
+                    count++;
+                }
+            }
+
+            if (count == 2 && candidates[1].length < candidates[0].length) {
+                swap(candidates[0], candidates[1]);
+            }
+
+            for (int k = 0; k < count; k++) {
+                if (clear(n, &candidates[k])) {
+                    *result = candidates[k];
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /// Turn towards side (+1 left, -1 right) until facing the target, then straight
+        bool dubinsToPoint(const hybrid_node& n, int side, dubins_shot *shot) {
+            double a = n.theta * CV_PI / 180;
+            double r = turn_radius;
+
+            // Turning circle centre, to the left of the heading for a left turn
+            double cx = n.x - side * r * sin(a);
+            double cy = n.y + side * r * cos(a);
+            double dx = target_pose.x - cx;
+            double dy = target_pose.y - cy;
+            double d = sqrt(dx * dx + dy * dy);
+            if (d <= r) {
+                return false; // inside the circle, needs more than one turn
+            }
+
+            // Angle of the bot and of the tangent point around the centre
+            double start = atan2(n.y - cy, n.x - cx);
+            double tangent = atan2(dy, dx) - side * acos(r / d);
+            double arc = side * (tangent - start);
+            arc = fmod(fmod(arc, 2 * CV_PI) + 2 * CV_PI, 2 * CV_PI);
+
+            shot->arc = side * arc;
+            shot->radius = r;
+            shot->straight = sqrt(d * d - r * r);
+            shot->length = arc * r + shot->straight;
+            return true;
+        }
+
+        /// Samples the shot against the occupancy grid and cuts it where it enters the goal region
+        bool clear(const hybrid_node& n, dubins_shot *shot) {
+            for (double d = 0; d <= shot->length + HYBRID_SHOT_STEP; d += HYBRID_SHOT_STEP) {
+                Triplet t = shotPose(n, *shot, min(d, shot->length));
+                if (!(((t.x >= 0) && (t.x < MAP_MAX)) && ((t.y >= 0) && (t.y < MAP_MAX)))) {
+                    return false;
+                }
+                if (occupancy.occupied(t.x, t.y)) {
+                    return false;
+                }
+                if (goal_region.contains(t.x, t.y)) {
+                    shot->length = min(d, shot->length);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /// Pose at distance d along the shot from n
+        static Triplet shotPose(const hybrid_node& n, const dubins_shot& shot, double d) {
+            double a = n.theta * CV_PI / 180;
+            double x = n.x, y = n.y;
+            double turned = shot.arc;
+            double arc_length = fabs(shot.arc) * shot.radius;
+
+            if (d < arc_length) {
+                turned = shot.arc * d / arc_length;
+            }
+            if (shot.arc != 0) {
+                // Chord of the arc turned so far
+                double side = shot.arc > 0 ? 1 : -1;
+                x += side * shot.radius * (sin(a + turned) - sin(a));
+                y -= side * shot.radius * (cos(a + turned) - cos(a));
+            }
+            if (d > arc_length) {
+                x += (d - arc_length) * cos(a + turned);
+                y += (d - arc_length) * sin(a + turned);
+            }
+
+            hybrid_node p;
+            p.x = x;
+            p.y = y;
+            p.theta = fmod(n.theta + turned * 180 / CV_PI + 360, 360);
+            return pose(p);
+        }
+
+        /// Seed ending closest to where the shot is after the same arc length
+        int closestSeed(const hybrid_node& n, const dubins_shot& shot) {
+            double a = n.theta * CV_PI / 180;
+            int best = -1;
+            double best_error = 0;
+
+            for (unsigned int i = 0; i < seeds.size(); i++) {
+                Triplet on_shot = shotPose(n, shot, min(seeds[i].cost, shot.length));
+                double x = n.x + seeds[i].dest.x * sin(a) + seeds[i].dest.y * cos(a);
+                double y = n.y - seeds[i].dest.x * cos(a) + seeds[i].dest.y * sin(a);
+                double error = (x - on_shot.x) * (x - on_shot.x) + (y - on_shot.y) * (y - on_shot.y);
+
+                if (best == -1 || error < best_error) {
+                    best = i;
+                    best_error = error;
+                }
+            }
+            return best;
+        }
+
+        /// Tightest turning radius of the seed set (arc length over heading change)
+        static double tightestRadius() {
+            double r = 0;
+            for (unsigned int i = 0; i < seeds.size(); i++) {
+                double turn = fabs((seeds[i].dest.z - 90) * CV_PI / 180);
+                if (turn > 0 && (r == 0 || seeds[i].cost / turn < r)) {
+                    r = seeds[i].cost / turn;
+                }
+            }
+            return r == 0 ? MIN_RAD : r;
+        }
+
+        bool allocated;
+        LatticeIndex index;
+        vector<hybrid_node> nodes;
+        IndexedHeap<double> heap;
+        Triplet target_pose;
+        double turn_radius;
+        dubins_shot shot; // of shot_node
+        int shot_node;
+        int expansions, peak_open;
+    };
+
+    HybridPlanner hybrid_planner;
+}
+
+#endif
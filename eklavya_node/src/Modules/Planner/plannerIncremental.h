@@ -0,0 +1,713 @@
+#ifndef _PLANNER_INCREMENTAL_H_
+#define _PLANNER_INCREMENTAL_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "plannerMethods.h"
+
+/**
+ * Incremental lattice planner (D* Lite).
+ *
+ * local_map is robot-centric, so the search tree is kept in a world frame
+ * instead: the frame of the map the tree was started on, on a grid of
+ * INCREMENTAL_WORLD cells a side with that map in the middle. The bot's pose
+ * in it is moved by the motion from EgoMotion (see move()). The search is
+ * rooted at the target and runs backwards to the bot, so a moving bot only
+ * moves the start of the search and the tree stays valid (the key modifier
+ * km of D* Lite accounts for the moving heuristic). The search can not hit
+ * the bot's own pose exactly, the path starts from the cheapest node of the
+ * tree near it in position and heading, and the tracker closes the gap.
+ *
+ * Each cycle the buckets of the world grid that hold edges of the tree and
+ * are in view of the current map are sampled from it again. Only the edges
+ * of the buckets whose cells changed are re-checked and repaired, so with a
+ * standing or moving bot the repair work follows the change of the map.
+ * World cells out of view keep what was last seen of them, cells never seen
+ * are occupied, as the map edge is for the other planners.
+ *
+ * The tree is started again when the target moves in the world frame, when
+ * the map drives off the world grid, or when it outgrows its budget.
+ */
+#define INCREMENTAL_WORLD 2400 // side of the world grid in cells; the keys of its states fit an int
+#define INCREMENTAL_WORLD_OFFSET ((INCREMENTAL_WORLD - MAP_MAX) / 2) // of the first map in the world grid
+// One spare word per row so a 64 cell window can always read two words
+#define INCREMENTAL_WORLD_WORDS (INCREMENTAL_WORLD / 64 + 2)
+#define INCREMENTAL_BUCKET 32 // side of a change tracking bucket, half a word of the world grid
+#define INCREMENTAL_BUCKETS_SIDE (INCREMENTAL_WORLD / INCREMENTAL_BUCKET)
+#define INCREMENTAL_START_RADIUS 15 // a node this close to the bot (cells) can start the path
+#define INCREMENTAL_START_TURN 30 // and this close in heading (degrees)
+#define INCREMENTAL_TARGET_SLACK 10 // the target may drift this far in the world (cells, degrees) before the tree is started again
+#define INCREMENTAL_MAX_NODES 200000
+#define INCREMENTAL_MAX_EDGES 1000000
+#define INF_COST 1e30
+
+namespace planner_space {
+
+    enum IncrementalStatus {
+        IncrementalPathFound = 0,
+        IncrementalNoPath = 1,
+        IncrementalBudgetExceeded = 2
+    };
+
+    typedef struct lpa_key {
+        double k1, k2;
+    } lpa_key;
+
+    struct LpaKeyLess : public std::binary_function<lpa_key, lpa_key, bool> {
+
+        bool operator() (lpa_key const& a, lpa_key const& b) const {
+            return a.k1 < b.k1 || (a.k1 == b.k1 && a.k2 < b.k2);
+        }
+    };
+
+    typedef struct lpa_node {
+        Triplet pose; // world frame, heading in [0, 360)
+        double g, rhs; // cost to the target
+        int parent_edge; // out edge that gives rhs, -1 if none
+        int first_in, first_out; // edge lists
+        bool expanded; // in edges generated
+        bool near_bot; // in the start region of the current cycle
+        int next_in_cell; // next node at the same (x, y), -1 at the end
+    } lpa_node;
+
+    typedef struct lpa_edge {
+        int from, to, seed_id;
+        double cost; // INF_COST while the seed is blocked
+        int next_in, next_out;
+        unsigned int checked_round;
+    } lpa_edge;
+
+    class IncrementalPlanner {
+    public:
+
+        IncrementalPlanner() : allocated(false), has_tree(false), starts_dirty(true), world(NULL), round(0), expansions(0), peak_open(0), collision_checks(0), goal(-1), km(0) {
+        }
+
+        ~IncrementalPlanner() {
+            delete [] world;
+        }
+
+        /// The bot moved by motion (see EgoMotion) since the last call
+        void move(TripletFP motion) {
+            if (!has_tree) {
+                return;
+            }
+
+            double phi = (bot_world.z - bot_map.z) * CV_PI / 180;
+            bot_world.x += motion.x * cos(phi) - motion.y * sin(phi);
+            bot_world.y += motion.x * sin(phi) + motion.y * cos(phi);
+            bot_world.z += motion.z;
+        }
+
+        /**
+         * Brings the search tree up to date with grid (the packed local_map)
+         * and target, and returns the node the bot's path starts from through
+         * start_node.
+         */
+        IncrementalStatus plan(Triplet bot, Triplet target, const OccupancyGrid& grid, int *start_node) {
+            if (!allocated) {
+                index.allocate();
+                cell_index.allocate();
+                world = new uint64_t[INCREMENTAL_WORLD * INCREMENTAL_WORLD_WORDS];
+                buckets.resize(INCREMENTAL_BUCKETS_SIDE * INCREMENTAL_BUCKETS_SIDE);
+                bucket_round.resize(buckets.size());
+                allocated = true;
+            }
+
+            collision_checks = 0;
+            if (has_tree) {
+                bot_map = bot;
+                setView();
+            }
+
+            if (!has_tree || targetMoved(target) || !mapOnWorld() ||
+                    nodes.size() > INCREMENTAL_MAX_NODES || edges.size() > INCREMENTAL_MAX_EDGES) {
+                reset(bot, target);
+            } else {
+                repair(grid);
+            }
+            view_grid = &grid;
+
+            // D* Lite: the heuristic to the bot shrank by at most how far it moved
+            km += hypot(bot_world.x - last_bot.x, bot_world.y - last_bot.y);
+            last_bot = bot_world;
+            findStarts();
+
+            expansions = 0;
+            peak_open = heap.size();
+            int best = -1;
+            starts_dirty = true;
+            while (true) {
+                if (starts_dirty) {
+                    best = bestStart();
+                    starts_dirty = false;
+                }
+
+                if (heap.empty()) {
+                    break;
+                }
+                if ((best != -1) && !keyLess(heap.topKey(), calculateKey(best))) {
+                    break;
+                }
+
+                int u = heap.top();
+                lpa_key key = calculateKey(u);
+                if (keyLess(heap.topKey(), key)) {
+                    // Queued before the bot moved, its key only grew since; once per node and cycle
+                    heap.update(u, key);
+                    continue;
+                }
+
+                if (expansions == MAX_ITER) {
+                    // Search state is kept, the next cycle resumes from here
+                    *start_node = best;
+                    return IncrementalBudgetExceeded;
+                }
+
+                heap.pop();
+                expansions++;
+                peak_open = max(peak_open, heap.size());
+                if (nodes[u].g > nodes[u].rhs) {
+                    nodes[u].g = nodes[u].rhs;
+                } else {
+                    nodes[u].g = INF_COST;
+                    updateVertex(u);
+                }
+
+                expand(u);
+                for (int e = nodes[u].first_in; e != -1; e = edges[e].next_in) {
+                    updateVertex(edges[e].from);
+                }
+
+                if (nodes[u].near_bot) {
+                    starts_dirty = true;
+                }
+            }
+
+            *start_node = best;
+            return best == -1 ? IncrementalNoPath : IncrementalPathFound;
+        }
+
+        int expansionCount() const {
+            return expansions;
+        }
+
+        int peakOpen() const {
+            return peak_open;
+        }
+
+        int collisionChecks() const {
+            return collision_checks;
+        }
+
+        double pathCost(int start_node) const {
+            return nodes[start_node].g;
+        }
+
+        /// Poses from start_node (excluded) to the target in the map frame, returns the seed of the first step
+        int extractPath(int start_node, vector<Triplet>& poses) {
+            int seed_id = nodes[start_node].parent_edge == -1 ? -1 : edges[nodes[start_node].parent_edge].seed_id;
+            int n = start_node;
+            unsigned int steps = 0;
+
+            poses.clear();
+            while (nodes[n].parent_edge != -1 && steps < nodes.size()) {
+                n = edges[nodes[n].parent_edge].to;
+                poses.push_back(toMap(nodes[n].pose));
+                steps++;
+            }
+
+            return n == goal ? seed_id : -1;
+        }
+
+    private:
+
+        void reset(Triplet bot, Triplet target) {
+            index.nextGeneration();
+            cell_index.nextGeneration();
+            nodes.clear();
+            edges.clear();
+            heap.clear();
+            start_nodes.clear();
+            for (unsigned int k = 0; k < live_buckets.size(); k++) {
+                buckets[live_buckets[k]].clear();
+            }
+            live_buckets.clear();
+            // Never seen is occupied
+            memset(world, 0xff, sizeof (uint64_t) * INCREMENTAL_WORLD * INCREMENTAL_WORLD_WORDS);
+            round++;
+
+            // The world frame is the frame of this map
+            bot_map = bot;
+            bot_world.x = bot.x + INCREMENTAL_WORLD_OFFSET;
+            bot_world.y = bot.y + INCREMENTAL_WORLD_OFFSET;
+            bot_world.z = bot.z;
+            last_bot = bot_world;
+            km = 0;
+            setView();
+
+            target_pose = toWorld(target);
+            goal = createNode(target_pose);
+            nodes[goal].rhs = 0;
+            heap.push(goal, calculateKey(goal));
+            has_tree = true;
+        }
+
+        bool targetMoved(Triplet target) const {
+            Triplet t = toWorld(target);
+            int turn = abs(wrapHeading(t.z - target_pose.z + 180) - 180);
+
+            return abs(t.x - target_pose.x) > INCREMENTAL_TARGET_SLACK ||
+                    abs(t.y - target_pose.y) > INCREMENTAL_TARGET_SLACK || turn > INCREMENTAL_TARGET_SLACK;
+        }
+
+        /// Are the corners of the current map on the world grid
+        bool mapOnWorld() const {
+            for (int corner = 0; corner < 4; corner++) {
+                double x = (corner & 1) ? MAP_MAX - 1 : 0;
+                double y = (corner & 2) ? MAP_MAX - 1 : 0;
+                double wx, wy;
+                mapToWorld(x, y, &wx, &wy);
+                if (!((0 <= wx && wx < INCREMENTAL_WORLD) && (0 <= wy && wy < INCREMENTAL_WORLD))) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        /// Samples the changed map into the live buckets in view and re-checks the edges of the ones that changed
+        void repair(const OccupancyGrid& grid) {
+            round++;
+            changed_buckets.clear();
+            for (unsigned int k = 0; k < live_buckets.size(); k++) {
+                int b = live_buckets[k];
+                if (inView(b) && sampleBucket(b, grid)) {
+                    changed_buckets.push_back(b);
+                }
+            }
+
+            view_grid = &grid;
+            for (unsigned int k = 0; k < changed_buckets.size(); k++) {
+                vector<int>& bucket = buckets[changed_buckets[k]];
+                for (unsigned int m = 0; m < bucket.size(); m++) {
+                    lpa_edge& edge = edges[bucket[m]];
+                    if (edge.checked_round == round) {
+                        continue;
+                    }
+                    edge.checked_round = round;
+
+                    double cost = edgeCost(nodes[edge.from].pose, edge.seed_id);
+                    if (cost != edge.cost) {
+                        edge.cost = cost;
+                        updateVertex(edge.from);
+                    }
+                }
+            }
+        }
+
+        /// Start region of this cycle: the nodes close to the bot in position and heading
+        void findStarts() {
+            for (unsigned int k = 0; k < start_nodes.size(); k++) {
+                nodes[start_nodes[k]].near_bot = false;
+            }
+            start_nodes.clear();
+
+            int x0 = (int) floor(bot_world.x + 0.5);
+            int y0 = (int) floor(bot_world.y + 0.5);
+            for (int x = x0 - INCREMENTAL_START_RADIUS; x <= x0 + INCREMENTAL_START_RADIUS; x++) {
+                for (int y = y0 - INCREMENTAL_START_RADIUS; y <= y0 + INCREMENTAL_START_RADIUS; y++) {
+                    if (!onWorld(x, y)) {
+                        continue;
+                    }
+
+                    for (int n = cell_index.find(x * INCREMENTAL_WORLD + y); n != -1; n = nodes[n].next_in_cell) {
+                        if (nearBot(nodes[n].pose)) {
+                            nodes[n].near_bot = true;
+                            start_nodes.push_back(n);
+                        }
+                    }
+                }
+            }
+        }
+
+        bool nearBot(Triplet pose) const {
+            double dx = pose.x - bot_world.x;
+            double dy = pose.y - bot_world.y;
+            int turn = abs(wrapHeading(pose.z - (int) floor(bot_world.z + 0.5) + 180) - 180);
+
+            return dx * dx + dy * dy <= INCREMENTAL_START_RADIUS * INCREMENTAL_START_RADIUS && turn <= INCREMENTAL_START_TURN;
+        }
+
+        int createNode(Triplet pose) {
+            lpa_node node;
+            node.pose = pose;
+            node.g = node.rhs = INF_COST;
+            node.parent_edge = -1;
+            node.first_in = node.first_out = -1;
+            node.expanded = false;
+            node.near_bot = nearBot(pose);
+
+            // Nodes at one cell are chained for findStarts()
+            int cell = pose.x * INCREMENTAL_WORLD + pose.y;
+            node.next_in_cell = cell_index.find(cell);
+
+            nodes.push_back(node);
+            int n = nodes.size() - 1;
+            index.insert(worldKey(pose), n);
+            cell_index.insert(cell, n);
+            if (node.near_bot) {
+                start_nodes.push_back(n);
+            }
+
+            return n;
+        }
+
+        /// Generates the in edges of n, from every pose a seed takes to n, on its first expansion
+        void expand(int n) {
+            if (nodes[n].expanded) {
+                return;
+            }
+            nodes[n].expanded = true;
+
+            for (int i = 0; i < seed_table.seedCount(); i++) {
+                Triplet pose = nodes[n].pose;
+
+                // A seed from heading z ends at seeds[i].dest.z - (90 - z)
+                Triplet prev;
+                prev.z = wrapHeading(pose.z - seeds[i].dest.z + 90);
+                const seed_entry& entry = seed_table.entry(prev.z, i);
+                prev.x = pose.x - entry.dest.x;
+                prev.y = pose.y - entry.dest.y;
+
+                if (!onWorld(prev.x, prev.y)) {
+                    continue;
+                }
+
+                int from = index.find(worldKey(prev));
+                if (from == -1) {
+                    from = createNode(prev);
+                }
+
+                lpa_edge edge;
+                edge.from = from;
+                edge.to = n;
+                edge.seed_id = i;
+                edge.cost = edgeCost(prev, i);
+                edge.next_out = nodes[from].first_out;
+                edge.next_in = nodes[n].first_in;
+                edge.checked_round = round;
+
+                edges.push_back(edge);
+                int e = edges.size() - 1;
+                nodes[from].first_out = e;
+                nodes[n].first_in = e;
+
+                registerEdge(e, prev, entry);
+            }
+        }
+
+        /// Files the edge under every bucket its swept cells touch
+        void registerEdge(int e, Triplet pose, const seed_entry& entry) {
+            int last = -1;
+            for (int k = entry.swept_begin; k < entry.swept_end; k++) {
+                int x = pose.x + seed_table.sweptCell(k).x;
+                int y = pose.y + seed_table.sweptCell(k).y;
+                if (!onWorld(x, y)) {
+                    continue;
+                }
+
+                int b = (x / INCREMENTAL_BUCKET) * INCREMENTAL_BUCKETS_SIDE + y / INCREMENTAL_BUCKET;
+                if (b != last && (buckets[b].empty() || buckets[b].back() != e)) {
+                    if (buckets[b].empty()) {
+                        live_buckets.push_back(b);
+                    }
+                    buckets[b].push_back(e);
+                }
+                last = b;
+            }
+        }
+
+        /// Seed cost of seed_id from pose on the world grid, INF_COST if blocked or off the grid
+        double edgeCost(Triplet pose, int seed_id) {
+            collision_checks++;
+            const seed_entry& e = seed_table.entry(pose.z, seed_id);
+            int x = pose.x;
+            int y = pose.y;
+
+            if (!(onWorld(x + e.lo.x, y + e.lo.y) && onWorld(x + e.hi.x, y + e.hi.y))) {
+                return INF_COST;
+            }
+
+            // Buckets no edge used before are sampled when first needed
+            for (int bx = (x + e.lo.x) / INCREMENTAL_BUCKET; bx <= (x + e.hi.x) / INCREMENTAL_BUCKET; bx++) {
+                for (int by = (y + e.lo.y) / INCREMENTAL_BUCKET; by <= (y + e.hi.y) / INCREMENTAL_BUCKET; by++) {
+                    int b = bx * INCREMENTAL_BUCKETS_SIDE + by;
+                    if (bucket_round[b] != round && inView(b)) {
+                        sampleBucket(b, *view_grid);
+                    }
+                }
+            }
+
+            for (int k = e.span_begin; k < e.span_end; k++) {
+                const swept_span& sp = seed_table.span(k);
+                if (worldWindow(x + sp.dx, y + sp.dy) & sp.mask) {
+                    return INF_COST;
+                }
+            }
+
+            return seeds[seed_id].cost;
+        }
+
+        /// Copies the map cells that fall on bucket b into the world grid, true if any changed
+        bool sampleBucket(int b, const OccupancyGrid& grid) {
+            bucket_round[b] = round;
+            int x0 = (b / INCREMENTAL_BUCKETS_SIDE) * INCREMENTAL_BUCKET;
+            int y0 = (b % INCREMENTAL_BUCKETS_SIDE) * INCREMENTAL_BUCKET;
+            int w = y0 / 64;
+            int shift = y0 % 64;
+            const uint64_t half = 0xffffffffu;
+
+            if (overFreeMap(x0, y0, grid)) {
+                // Most of the world is free, it needs no sampling
+                bool changed = false;
+                for (int x = x0; x < x0 + INCREMENTAL_BUCKET; x++) {
+                    uint64_t *row = world + x * INCREMENTAL_WORLD_WORDS;
+                    changed = changed || (row[w] & (half << shift));
+                    row[w] &= ~(half << shift);
+                }
+                return changed;
+            }
+
+            bool changed = false;
+            for (int x = x0; x < x0 + INCREMENTAL_BUCKET; x++) {
+                uint64_t *row = world + x * INCREMENTAL_WORLD_WORDS;
+                uint64_t old_bits = (row[w] >> shift) & half;
+                uint64_t bits = old_bits;
+
+                // Map position of (x, y0), a step along the world's y is (sin, cos) in the map
+                double mx, my;
+                worldToMap(x, y0, &mx, &my);
+                mx += 0.5;
+                my += 0.5;
+                for (int k = 0; k < INCREMENTAL_BUCKET; k++, mx += view_sin, my += view_cos) {
+                    if (!(((0 <= mx) && (mx < MAP_MAX)) && ((0 <= my) && (my < MAP_MAX)))) {
+                        continue;
+                    }
+
+                    if (grid.occupied((int) mx, (int) my)) {
+                        bits |= (uint64_t) 1 << k;
+                    } else {
+                        bits &= ~((uint64_t) 1 << k);
+                    }
+                }
+
+                if (bits != old_bits) {
+                    row[w] = (row[w] & ~(half << shift)) | (bits << shift);
+                    changed = true;
+                }
+            }
+
+            return changed;
+        }
+
+        /// Does the bucket at (x0, y0) lie on the current map, on free cells only
+        bool overFreeMap(int x0, int y0, const OccupancyGrid& grid) const {
+            double lo_x = MAP_MAX, lo_y = MAP_MAX, hi_x = -1, hi_y = -1;
+            for (int corner = 0; corner < 4; corner++) {
+                double mx, my;
+                worldToMap(x0 + ((corner & 1) ? INCREMENTAL_BUCKET - 1 : 0),
+                        y0 + ((corner & 2) ? INCREMENTAL_BUCKET - 1 : 0), &mx, &my);
+                lo_x = min(lo_x, mx);
+                lo_y = min(lo_y, my);
+                hi_x = max(hi_x, mx);
+                hi_y = max(hi_y, my);
+            }
+
+            // The rounded samples stay within a cell of the corners' box, at most 48 cells wide
+            int x_lo = (int) floor(lo_x) - 1, y_lo = (int) floor(lo_y) - 1;
+            int x_hi = (int) ceil(hi_x) + 1, y_hi = (int) ceil(hi_y) + 1;
+            if (!((0 <= x_lo && x_hi < MAP_MAX) && (0 <= y_lo && y_hi < MAP_MAX))) {
+                return false;
+            }
+
+            uint64_t mask = ((uint64_t) 1 << (y_hi - y_lo + 1)) - 1;
+            for (int x = x_lo; x <= x_hi; x++) {
+                if (grid.window(x, y_lo) & mask) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        /// Does some cell of bucket b lie on the current map
+        bool inView(int b) const {
+            double half = 0.5 * INCREMENTAL_BUCKET;
+            double mx, my;
+            worldToMap((b / INCREMENTAL_BUCKETS_SIDE) * INCREMENTAL_BUCKET + half,
+                    (b % INCREMENTAL_BUCKETS_SIDE) * INCREMENTAL_BUCKET + half, &mx, &my);
+
+            // Half the bucket's diagonal around its centre
+            double reach = half * 1.5;
+            return mx > -reach && mx < MAP_MAX + reach && my > -reach && my < MAP_MAX + reach;
+        }
+
+        /// World cells (x, y) .. (x, y + 63) as bits 0..63
+        uint64_t worldWindow(int x, int y) const {
+            const uint64_t *row = world + x * INCREMENTAL_WORLD_WORDS;
+            int w = y / 64;
+            int shift = y % 64;
+
+            if (shift == 0) {
+                return row[w];
+            }
+            return (row[w] >> shift) | (row[w + 1] << (64 - shift));
+        }
+
+        void updateVertex(int n) {
+            if (n != goal) {
+                nodes[n].rhs = INF_COST;
+                nodes[n].parent_edge = -1;
+                for (int e = nodes[n].first_out; e != -1; e = edges[e].next_out) {
+                    double g_to = nodes[edges[e].to].g;
+                    if (edges[e].cost >= INF_COST || g_to >= INF_COST) {
+                        continue;
+                    }
+
+                    if (g_to + edges[e].cost < nodes[n].rhs) {
+                        nodes[n].rhs = g_to + edges[e].cost;
+                        nodes[n].parent_edge = e;
+                    }
+                }
+            }
+
+            if (nodes[n].near_bot) {
+                starts_dirty = true;
+            }
+
+            if (nodes[n].g != nodes[n].rhs) {
+                if (heap.contains(n)) {
+                    heap.update(n, calculateKey(n));
+                } else {
+                    heap.push(n, calculateKey(n));
+                }
+            } else if (heap.contains(n)) {
+                heap.remove(n);
+            }
+        }
+
+        /// Consistent start region node with the lowest cost from the bot, -1 if none
+        int bestStart() {
+            int best = -1;
+            double best_cost = INF_COST;
+            for (unsigned int k = 0; k < start_nodes.size(); k++) {
+                int n = start_nodes[k];
+                if (nodes[n].g >= INF_COST || nodes[n].g != nodes[n].rhs) {
+                    continue;
+                }
+
+                double cost = nodes[n].g + botDistance(n);
+                if (cost < best_cost) {
+                    best = n;
+                    best_cost = cost;
+                }
+            }
+            return best;
+        }
+
+        lpa_key calculateKey(int n) {
+            lpa_key key;
+            double m = min(nodes[n].g, nodes[n].rhs);
+            key.k1 = m + botDistance(n) + km;
+            key.k2 = m;
+            return key;
+        }
+
+        double botDistance(int n) const {
+            return hypot(nodes[n].pose.x - bot_world.x, nodes[n].pose.y - bot_world.y);
+        }
+
+        static bool keyLess(const lpa_key& a, const lpa_key& b) {
+            return LpaKeyLess()(a, b);
+        }
+
+        /// Rotation of the current map against the world frame, set from the bot's poses in both
+        void setView() {
+            double phi = (bot_world.z - bot_map.z) * CV_PI / 180;
+            view_cos = cos(phi);
+            view_sin = sin(phi);
+        }
+
+        void mapToWorld(double x, double y, double *wx, double *wy) const {
+            double dx = x - bot_map.x;
+            double dy = y - bot_map.y;
+            *wx = bot_world.x + dx * view_cos - dy * view_sin;
+            *wy = bot_world.y + dx * view_sin + dy * view_cos;
+        }
+
+        void worldToMap(double x, double y, double *mx, double *my) const {
+            double dx = x - bot_world.x;
+            double dy = y - bot_world.y;
+            *mx = bot_map.x + dx * view_cos + dy * view_sin;
+            *my = bot_map.y - dx * view_sin + dy * view_cos;
+        }
+
+        Triplet toWorld(Triplet pose) const {
+            double wx, wy;
+            mapToWorld(pose.x, pose.y, &wx, &wy);
+            return roundPose(wx, wy, pose.z + bot_world.z - bot_map.z);
+        }
+
+        Triplet toMap(Triplet pose) const {
+            double mx, my;
+            worldToMap(pose.x, pose.y, &mx, &my);
+            return roundPose(mx, my, pose.z - (bot_world.z - bot_map.z));
+        }
+
+        static Triplet roundPose(double x, double y, double z) {
+            Triplet pose;
+            pose.x = (int) floor(x + 0.5);
+            pose.y = (int) floor(y + 0.5);
+            pose.z = wrapHeading((int) floor(z + 0.5));
+            return pose;
+        }
+
+        static int wrapHeading(int z) {
+            return ((z % 360) + 360) % 360;
+        }
+
+        static bool onWorld(int x, int y) {
+            return ((0 <= x) && (x < INCREMENTAL_WORLD)) && ((0 <= y) && (y < INCREMENTAL_WORLD));
+        }
+
+        /// pose must lie on the world grid
+        static int worldKey(Triplet pose) {
+            return (pose.x * INCREMENTAL_WORLD + pose.y) * LATTICE_HEADINGS + LatticeIndex::headingBin(pose.z);
+        }
+
+        bool allocated, has_tree, starts_dirty;
+        LatticeIndex index;
+        LatticeIndex cell_index; // (x, y) to the last node created there
+        vector<lpa_node> nodes;
+        vector<lpa_edge> edges;
+        IndexedHeap<lpa_key, LpaKeyLess> heap;
+        vector<int> start_nodes;
+        vector< vector<int> > buckets; // edges sweeping each bucket of the world grid
+        vector<int> live_buckets; // buckets holding edges
+        vector<unsigned int> bucket_round; // round a bucket was last sampled in
+        vector<int> changed_buckets; // scratch, kept to avoid reallocating
+        uint64_t *world; // occupancy in the world frame, rows of INCREMENTAL_WORLD_WORDS words as in OccupancyGrid
+        const OccupancyGrid *view_grid; // map of the current cycle
+        unsigned int round;
+        int expansions, peak_open, collision_checks; // of the last plan()
+        Triplet bot_map, target_pose; // bot in the map, target in the world
+        TripletFP bot_world, last_bot; // bot in the world, now and at the last plan()
+        double view_cos, view_sin;
+        int goal;
+        double km;
+    };
+
+    IncrementalPlanner incremental_planner;
+}
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef _PLANNER_LATTICE_H_
+#define _PLANNER_LATTICE_H_
+
+#include <string.h>
+#include "../../eklavya2.h"
+
+/**
+ * Headings a state key tells apart: every integer degree, so each
+ * (x, y, heading) state is its own node as with the old pose map. Callers
+ * that want to merge headings (hybrid A*) pass fewer bins to key().
+ */
+#define LATTICE_HEADINGS 360
+
+/// Initial slots of the index, it doubles whenever it gets half full
+#define LATTICE_INITIAL_SLOTS (1 << 17)
+
+namespace planner_space {
+
+    typedef struct lattice_cell {
+        unsigned int generation;
+        int key;
+        int node;
+    } lattice_cell;
+
+    /**
+     * (x, y, heading) index of the nodes of one search: an open addressing
+     * hash table sized by the nodes actually generated, not by the map
+     * (a few MB for MAX_ITER expansions). Slots are only valid while their
+     * generation matches the current one, so starting a new search is O(1)
+     * and the table never has to be cleared between cycles.
+     */
+    class LatticeIndex {
+    public:
+
+        LatticeIndex() : cells(NULL), mask(0), count(0), generation(1) {
+        }
+
+        ~LatticeIndex() {
+            delete [] cells;
+        }
+
+        void allocate() {
+            if (cells == NULL) {
+                resize(LATTICE_INITIAL_SLOTS);
+            }
+        }
+
+        void nextGeneration() {
+            generation++;
+            count = 0;
+            if (generation == 0) {
+                // Counter wrapped, stale slots could alias the new generation
+                memset(cells, 0, sizeof (lattice_cell) * (mask + 1));
+                generation = 1;
+            }
+        }
+
+        static int headingBin(int z, int bins = LATTICE_HEADINGS) {
+            int heading = ((z % 360) + 360) % 360;
+            return heading * bins / 360;
+        }
+
+        /// pose must lie inside the map
+        static int key(Triplet pose, int bins = LATTICE_HEADINGS) {
+            return (pose.x * MAP_MAX + pose.y) * bins + headingBin(pose.z, bins);
+        }
+
+        /// Returns the node stored at key in this generation, -1 if none
+        int find(int key) const {
+            for (unsigned int i = slot(key);; i = (i + 1) & mask) {
+                if (cells[i].generation != generation) {
+                    return -1;
+                }
+                if (cells[i].key == key) {
+                    return cells[i].node;
+                }
+            }
+        }
+
+        void insert(int key, int node) {
+            unsigned int i = slot(key);
+            while (cells[i].generation == generation && cells[i].key != key) {
+                i = (i + 1) & mask;
+            }
+
+            if (cells[i].generation != generation) {
+                count++;
+            }
+            cells[i].generation = generation;
+            cells[i].key = key;
+            cells[i].node = node;
+
+            if (2 * count > mask + 1) {
+                resize(2 * (mask + 1));
+            }
+        }
+
+    private:
+
+        unsigned int slot(int key) const {
+            unsigned int h = (unsigned int) key * 2654435761u;
+            return (h ^ (h >> 16)) & mask;
+        }
+
+        /// Moves the slots of this generation into a table of size slots (a power of two)
+        void resize(unsigned int size) {
+            lattice_cell *old = cells;
+            unsigned int old_size = old == NULL ? 0 : mask + 1;
+
+            cells = new lattice_cell[size];
+            memset(cells, 0, sizeof (lattice_cell) * size);
+            mask = size - 1;
+
+            for (unsigned int i = 0; i < old_size; i++) {
+                if (old[i].generation == generation) {
+                    unsigned int j = slot(old[i].key);
+                    while (cells[j].generation == generation) {
+                        j = (j + 1) & mask;
+                    }
+                    cells[j] = old[i];
+                }
+            }
+
+            delete [] old;
+        }
+
+        lattice_cell *cells;
+        unsigned int mask; // slots - 1
+        unsigned int count; // slots used in this generation
+        unsigned int generation; // never 0, the value of cleared slots
+    };
+}
+
+#endif
@@ -1,17 +1,38 @@
+#ifndef _PLANNER_METHODS_H_
+#define _PLANNER_METHODS_H_
+
 #include "planner.h"
+#include "plannerLattice.h"
+#include "plannerSeedTable.h"
+#include "plannerCostField.h"
+#include "plannerHeap.h"
+#include "plannerHeuristic.h"
+#include "plannerGoal.h"
+#include "plannerReuse.h"
+#include "plannerCoarse.h"
+#include "plannerWorkspace.h"
+#include "plannerTracker.h"
+#include "plannerDynamic.h"
 
 /**
  * Control Modes:
  * 0: No PID
  * 1: Yaw PID with NO Thread
  * 2: Yaw PID with Controller Thread
+ * 3: Pure pursuit on the published path, run by tracker_thread (see plannerTracker.h),
+ *    which alone sends the wheel commands
  */
 #define PID_MODE 0
 #define SIMCTL
 #define SIM_SEEDS
 //#define DEBUG
+#ifndef PLANNER_HEADLESS // defined by the benchmark build, no windows or console chatter
 #define SHOW_PATH
+#endif
 //#define FLEX
+#define LAZY_COLLISION // check a seed for collisions when its end node is popped, not when it is generated
+#define PATH_REUSE // follow the last path while it stays valid instead of searching, see plannerReuse.h
+#define COARSE_CORRIDOR // search inside the corridor of a coarse path first, see plannerCoarse.h
 
 /**
  * Seed Files: 
@@ -25,96 +46,56 @@
 
 #ifdef SIM_SEEDS
 #define SEEDS_FILE "../src/Modules/Planner/seeds2.txt"
+#define HEURISTIC_FILE "../src/Modules/Planner/heuristic2.lut"
 #else
 #define SEEDS_FILE "../src/Modules/Planner/seeds1.txt"
+#define HEURISTIC_FILE "../src/Modules/Planner/heuristic1.lut"
 #endif
-#define OPEN 1
-#define CLOSED 2
-#define UNASSIGNED 3
 #define VMAX 70
 #define MAX_ITER 10000
 #define MIN_RAD 70
 
+/**
+ * Anytime (ARA*) search: starts with the heuristic inflated by ANYTIME_EPS_START
+ * and tightens it by ANYTIME_EPS_STEP while the per cycle budget lasts.
+ */
+#define ANYTIME_BUDGET 0.08 // seconds
+#define ANYTIME_EPS_START 3.0
+#define ANYTIME_EPS_STEP 0.5
+
 using namespace std;
 
 namespace planner_space {
 
-    typedef struct state { // elemental data structure of openset
-        Triplet pose;
-        double g_dist, h_dist; // costs
-        int seed_id;
-        double g_obs, h_obs;
-        int depth;
-    } state;
-
-    typedef struct seed_point {
-        double x, y;
-    } seed_point;
-
-    typedef struct seed {
-        Triplet dest;
-        double cost;
-        double k; // velocity ratio
-        double vl, vr; // individual velocities
-        vector<seed_point> seed_points;
-    } seed;
-
-    typedef struct open_map_element {
-        char membership;
-        double cost;
-    } open_map_element;
-
-    struct PoseCompare : public std::binary_function<Triplet, Triplet, bool> {
-
-        bool operator() (Triplet const& triplet_1, Triplet const& triplet_2) const {
-            double k11 = triplet_1.x;
-            double k12 = triplet_1.y;
-            double k13 = triplet_1.z;
-
-            double cantor11 = 0.5 * (k11 + k12) * (k11 + k12 + 1) + k12;
-            double cantor12 = 0.5 * (cantor11 + k13) * (cantor11 + k13 + 1) + k13;
-
-            double k21 = triplet_2.x;
-            double k22 = triplet_2.y;
-            double k23 = triplet_2.z;
-
-            double cantor21 = 0.5 * (k21 + k22) * (k21 + k22 + 1) + k22;
-            double cantor22 = 0.5 * (cantor21 + k23) * (cantor21 + k23 + 1) + k23;
-
-            return cantor12 < cantor22;
-        }
-    };
-
-    struct StateCompare : public std::binary_function<state, state, bool> {
-
-        bool operator() (state const& state_1, state const& state_2) const {
-            double f1 = state_1.g_dist + state_1.h_dist;
-            double f2 = state_2.g_dist + state_2.h_dist;
-
-#ifdef DistTransform
-            f1 += state_1.g_obs + state_1.h_obs;
-            f2 += state_2.g_obs + state_2.h_obs;
-#endif
-
-            return f1 > f2;
-        }
-    };
-
-    struct StateCompareDT : public std::binary_function<state, state, bool> {
-
-        bool operator() (state const& state_1, state const& state_2) const {
-            double f1 = state_1.g_dist + state_1.h_dist;
-            double f2 = state_2.g_dist + state_2.h_dist;
-            f1 += state_1.g_obs + state_1.h_obs;
-            f2 += state_2.g_obs + state_2.h_obs;
-
-            return f1 > f2;
-        }
-    };
-
     Triplet bot, target;
     vector<seed> seeds;
+    SeedTable seed_table;
+    HeuristicTable heuristic_table; // generated for SEEDS_FILE by heuristic_generator
+    OccupancyGrid occupancy; // local_map packed for collision checks
+    SearchWorkspace main_workspace; // searches of the planner thread, on the seeds above
+
+    LatticeIndex& lattice = main_workspace.lattice;
+    vector<lattice_node>& nodes = main_workspace.nodes;
+    IndexedHeap<double>& open_list = main_workspace.open_list; // node ids keyed on f
+    planner_stats& search_stats = main_workspace.stats;
+
+    /**
+     * Per search scratch space. Like the node pool these are cleared, never
+     * freed, so after the first cycles planning does no heap allocation.
+     */
+    vector<state>& successors = main_workspace.successors;
+    vector<int> incons, reopened;
+
+    GoalRegion goal_region; // target of the current query
+    PathReuse path_reuse; // last path found by findPath / findPathDT
+    PathTracker path_tracker; // PID_MODE 3
+    CostField cost_field;
+    CoarseGrid coarse_grid; // occupancy max-pooled for the corridor
+    ObstaclePrediction obstacle_prediction; // moving obstacles, findPathDynamic
+    OccupancyGrid dynamic_occupancy; // occupancy without the moving obstacles
+    cv::Mat canvas; // path display, allocated once
     Tserial *p;
+    pthread_mutex_t serial_mutex = PTHREAD_MUTEX_INITIALIZER; // p, written by the planner and the controller or tracker thread
 
     pthread_mutex_t controllerMutex;
     volatile double targetCurvature = 1;
@@ -150,6 +131,7 @@ namespace planner_space {
             ROS_INFO("[INFO] [Controller] %lf , %lf , %d , %d", myTargetCurvature, (myYaw - previousYaw)*2, left_vel, right_vel);
 
 #ifndef SIMCTL
+            pthread_mutex_lock(&serial_mutex);
 
             p->sendChar('w');
             usleep(100);
@@ -162,6 +144,8 @@ namespace planner_space {
             usleep(100);
             p->sendChar('0' + right_vel % 10);
             usleep(100);
+
+            pthread_mutex_unlock(&serial_mutex);
 #endif
 
             usleep(10000);
@@ -170,11 +154,16 @@ namespace planner_space {
         return NULL;
     }
 
-    void loadSeeds() {
+    /// Appends the seeds of file to out, false if the file can not be opened
+    bool loadSeeds(const char *file, vector<seed>& out) {
         int n_seeds;
         int return_status;
         double x, y, z;
-        FILE *fp = fopen(SEEDS_FILE, "r");
+        FILE *fp = fopen(file, "r");
+        if (fp == NULL) {
+            return false;
+        }
+
         return_status = fscanf(fp, "%d\n", &n_seeds);
         if (return_status == 0) {
             ROS_ERROR("[PLANNER] Incorrect seed file format");
@@ -224,19 +213,57 @@ namespace planner_space {
 
                 s.seed_points.insert(s.seed_points.begin(), point);
             }
-            seeds.insert(seeds.begin(), s);
+            out.insert(out.begin(), s);
         }
+
+        fclose(fp);
+        return true;
+    }
+
+    void allocateLattice() {
+        main_workspace.bind(seeds, seed_table, heuristic_table, occupancy);
+        main_workspace.allocate(MAX_ITER);
+    }
+
+    /// Starts a new search in main_workspace, invalidating every node of the previous one
+    void resetSearch() {
+        main_workspace.reset();
+    }
+
+    /// Returns the node for pose, -1 if it has not been generated in this search
+    int findNode(Triplet pose) {
+        return main_workspace.findNode(pose);
+    }
+
+    int addNode(state s, int parent) {
+        return main_workspace.addNode(s, parent);
+    }
+
+    /// See SearchWorkspace::relaxNode()
+    void relaxNode(state s, int parent, double f) {
+        main_workspace.relaxNode(s, parent, f);
+    }
+
+    void countExpansion() {
+        main_workspace.countExpansion();
+    }
+
+    /// ARA* key, the heuristic inflated by eps
+    double anytimeKey(int n, double eps) {
+        return nodes[n].s.g_dist + eps * nodes[n].s.h_dist;
     }
 
     double distance(Triplet a, Triplet b) {
         return sqrt((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y));
     }
 
-    bool isEqual(state a, state b) {
-        double error = sqrt((a.pose.x - b.pose.x) * (a.pose.x - b.pose.x) +
-                (a.pose.y - b.pose.y) * (a.pose.y - b.pose.y));
+    /// Euclidean distance, raised to the seed lattice's cost-to-go where the heuristic table knows it
+    double heuristic(Triplet a, Triplet b) {
+        return main_workspace.heuristic(a, b);
+    }
 
-        return error < 35;
+    bool isEqual(const state& a, const GoalRegion& goal) {
+        return goal.contains(a.pose.x, a.pose.y);
     }
 
     bool targetReached(state a, state b) {
@@ -269,6 +296,16 @@ namespace planner_space {
                 0);
     }
 
+    /// Map to draw the path on, the map snapshot itself is shared and read-only
+    cv::Mat drawableMap(cv::Mat map_img) {
+#if defined(SHOW_PATH) || defined(DEBUG)
+        map_img.copyTo(canvas);
+        return canvas;
+#else
+        return map_img;
+#endif
+    }
+
     void startThread(pthread_t *thread_id, pthread_attr_t *thread_attr, void *(*thread_name) (void *)) {
         if (pthread_create(thread_id, thread_attr, thread_name, NULL)) {
             cout << "[PLANNER] [ERROR] Unable to create thread" << endl;
@@ -302,13 +339,57 @@ namespace planner_space {
 #endif
     }
 
-    geometry_msgs::Twist sendCommand(seed s) {
+    /// Sends wheel velocities to the bot, and returns them as a twist
+    geometry_msgs::Twist wheelCommand(int left_vel, int right_vel) {
+        geometry_msgs::Twist cmdvel;
+
+#ifndef SIMCTL
+        char arr[] = {'w',
+            '0' + left_vel / 10,
+            '0' + left_vel % 10,
+            '0' + right_vel / 10,
+            '0' + right_vel % 10, '/0'};
+
+        pthread_mutex_lock(&serial_mutex);
+        p->sendArray(arr, 5);
+        usleep(100);
+        pthread_mutex_unlock(&serial_mutex);
+#endif  
+
+        left_vel = left_vel > 80 ? 80 : left_vel;
+        right_vel = right_vel > 80 ? 80 : right_vel;
+        left_vel = left_vel < -80 ? -80 : left_vel;
+        right_vel = right_vel < -80 ? -80 : right_vel;
+
+        double scale = 100;
+        double w = 0.55000000;
+        cmdvel.linear.x = (left_vel + right_vel) / (2 * scale);
+        cmdvel.linear.y = 0;
+        cmdvel.linear.z = 0;
+        cmdvel.angular.x = 0;
+        cmdvel.angular.y = 0;
+        cmdvel.angular.z = (left_vel - right_vel) / (w * scale);
+
+        return cmdvel;
+    }
+
+    geometry_msgs::Twist sendCommand(const seed& s) {
         geometry_msgs::Twist cmdvel;
 
         int left_vel = 0;
         int right_vel = 0;
         float left_velocity = s.vl;
         float right_velocity = s.vr;
+        double k = s.k;
+
+        if (PID_MODE == 3) {
+            // The tracker thread drives the wheels: a forward seed leaves it on the
+            // path just published, a stop or reverse is held until the next one
+            if ((left_velocity < 0) || (right_velocity < 0) || ((left_velocity == 0) && (right_velocity == 0))) {
+                path_tracker.hold(left_velocity, right_velocity);
+            }
+            return cmdvel;
+        }
 
         if ((left_velocity == 0) && (right_velocity == 0)) {
             return cmdvel;
@@ -319,21 +400,27 @@ namespace planner_space {
                     if (left_velocity == right_velocity) {
                         double vavg = 80;
                         left_vel = right_vel = vavg;
+#ifndef PLANNER_HEADLESS
 			printf("straight seed\n");
-                    } else if (s.k == 1.258574 || s.k == 0.794550) {
+#endif
+                    } else if (k == 1.258574 || k == 0.794550) {
                         double vavg = 50;
                         double aggression = 1;
-                        s.k = s.k < 1 ? s.k / aggression : s.k * aggression;
-                        left_vel = (int) 2 * vavg * s.k / (1 + s.k);
+                        k = k < 1 ? k / aggression : k * aggression;
+                        left_vel = (int) 2 * vavg * k / (1 + k);
                         right_vel = (int) (2 * vavg - left_vel);
+#ifndef PLANNER_HEADLESS
 			printf("soft seed\n");
-                    } else if (s.k == 1.352941 || s.k == 0.739130) {
+#endif
+                    } else if (k == 1.352941 || k == 0.739130) {
                         double vavg = 20;
                         double aggression = 1.5;
-                        s.k = s.k < 1 ? s.k / aggression : s.k * aggression;
-                        left_vel = (int) 2 * vavg * s.k / (1 + s.k);
+                        k = k < 1 ? k / aggression : k * aggression;
+                        left_vel = (int) 2 * vavg * k / (1 + k);
                         right_vel = (int) (2 * vavg - left_vel);
+#ifndef PLANNER_HEADLESS
 			printf("hard seed\n");
+#endif
                     }
 
                     break;
@@ -353,15 +440,15 @@ namespace planner_space {
                     double error = (myTargetCurvature - (myYaw - previousYaw) / 0.37);
                     errorSum += error;
 
-                    if (s.k > 1.35) {
+                    if (k > 1.35) {
                         mode = 2;
-                    } else if (s.k > 1.25) {
+                    } else if (k > 1.25) {
                         mode = 3;
-                    } else if (s.k > 0.99) {
+                    } else if (k > 0.99) {
                         mode = 4;
-                    } else if (s.k > 0.79) {
+                    } else if (k > 0.79) {
                         mode = 5;
-                    } else if (s.k > 0.73) {
+                    } else if (k > 0.73) {
                         mode = 6;
                     } else {
                         mode = 4;
@@ -401,8 +488,8 @@ namespace planner_space {
                 case 2:
                 {
                     pthread_mutex_lock(&controllerMutex);
-                    targetCurvature = 5.0 * ((double) (s.k - 1.0)) / (s.k + 1.0);
-                    ROS_INFO("Updated : %lf, k = %lf, left = %lf, right = %lf", targetCurvature, s.k, s.vl, s.vr);
+                    targetCurvature = 5.0 * ((double) (k - 1.0)) / (k + 1.0);
+                    ROS_INFO("Updated : %lf, k = %lf, left = %lf, right = %lf", targetCurvature, k, s.vl, s.vr);
                     pthread_mutex_unlock(&controllerMutex);
 
                     break;
@@ -415,22 +502,6 @@ namespace planner_space {
             right_vel = right_velocity;
         }
 
-#ifndef SIMCTL
-        char arr[] = {'w',
-            '0' + left_vel / 10,
-            '0' + left_vel % 10,
-            '0' + right_vel / 10,
-            '0' + right_vel % 10, '/0'};
-
-        p->sendArray(arr, 5);
-        usleep(100);
-#endif  
-
-        left_vel = left_vel > 80 ? 80 : left_vel;
-        right_vel = right_vel > 80 ? 80 : right_vel;
-        left_vel = left_vel < -80 ? -80 : left_vel;
-        right_vel = right_vel < -80 ? -80 : right_vel;
-
         //	if(s.vl==-30&&s.vr==30)
         //	{
         //	left_vel=-30;
@@ -442,38 +513,42 @@ namespace planner_space {
         //	right_vel=-30;
         //	}
 
-        double scale = 100;
-        double w = 0.55000000;
-        cmdvel.linear.x = (left_vel + right_vel) / (2 * scale);
-        cmdvel.linear.y = 0;
-        cmdvel.linear.z = 0;
-        cmdvel.angular.x = 0;
-        cmdvel.angular.y = 0;
-        cmdvel.angular.z = (left_vel - right_vel) / (w * scale);
+        cmdvel = wheelCommand(left_vel, right_vel);
 
 //        std::cout << "linear: " << cmdvel.linear.x << " angular: " << cmdvel.angular.z << std::endl;
         ROS_INFO("[Planner] Command : (%d, %d)", left_vel, right_vel);
         return cmdvel;
     }
 
-    geometry_msgs::Twist reconstructPath(map<Triplet, state, PoseCompare> came_from, state current, cv::Mat inputImgP) {
+    /// Publishes the path ending at node current of the search in ws, and returns its first command
+    geometry_msgs::Twist reconstructPath(const SearchWorkspace& ws, int current, cv::Mat inputImgP) {
+        const vector<lattice_node>& nodes = ws.nodes;
+        const vector<seed>& seeds = *ws.seeds;
+
         pthread_mutex_lock(&path_mutex);
 
+        search_stats.path_cost = nodes[current].s.g_dist;
+
         geometry_msgs::Twist cmdvel;
 
         path.clear();
+        path_reuse.clear();
 
         int seed_id = -1;
-        state s = current;
-        while (came_from.find(s.pose) != came_from.end()) {
+        int n = current;
+        while (nodes[n].parent != -1) {
 #if defined SHOW_PATH || defined DEBUG
-            plotPoint(inputImgP, s.pose);
+            plotPoint(inputImgP, nodes[n].s.pose);
 #endif
 
-            path.insert(path.begin(), s.pose);
-            seed_id = s.seed_id;
-            s = came_from[s.pose];
+            path.push_back(nodes[n].s.pose);
+            seed_id = nodes[n].s.seed_id;
+            path_reuse.addStep(nodes[nodes[n].parent].s.pose, seed_id, seeds[seed_id].cost);
+            n = nodes[n].parent;
         }
+        reverse(path.begin(), path.end());
+        path_tracker.follow(path, nodes[n].s.pose);
+        path_reuse.record(nodes[n].s.pose, nodes[current].s.pose, seeds, *ws.seed_table);
 
         pthread_mutex_unlock(&path_mutex);
 
@@ -521,19 +596,24 @@ namespace planner_space {
         return cmdvel;
     }
 
-    void reconstructPath(map<Triplet, state, PoseCompare> came_from, cv::Mat inputImgP, state current) {
+    geometry_msgs::Twist reconstructPath(int current, cv::Mat inputImgP) {
+        return reconstructPath(main_workspace, current, inputImgP);
+    }
+
+    void reconstructPath(cv::Mat inputImgP, int current) {
         pthread_mutex_lock(&path_mutex);
 
         path.clear();
 
         int seed_id = -1;
-        state s = current;
-        while (came_from.find(s.pose) != came_from.end()) {
-            plotPoint(inputImgP, s.pose);
-            path.insert(path.begin(), s.pose);
-            seed_id = s.seed_id;
-            s = came_from[s.pose];
+        int n = current;
+        while (nodes[n].parent != -1) {
+            plotPoint(inputImgP, nodes[n].s.pose);
+            path.push_back(nodes[n].s.pose);
+            seed_id = nodes[n].s.seed_id;
+            n = nodes[n].parent;
         }
+        reverse(path.begin(), path.end());
 
         cv::imshow("[PLANNER] Map", inputImgP);
         cvWaitKey(WAIT_TIME);
@@ -548,55 +628,14 @@ namespace planner_space {
         }
     }
 
-    vector<state> neighborNodes(state current) {
-        vector<state> neighbours;
-        for (unsigned int i = 0; i < seeds.size(); i++) {
-            state neighbour;
-            double sx = seeds[i].dest.x;
-            double sy = seeds[i].dest.y;
-            double sz = seeds[i].dest.z;
-
-            neighbour.pose.x = (int) (current.pose.x +
-                    sx * sin(current.pose.z * (CV_PI / 180)) +
-                    sy * cos(current.pose.z * (CV_PI / 180)));
-            neighbour.pose.y = (int) (current.pose.y +
-                    -sx * cos(current.pose.z * (CV_PI / 180)) +
-                    sy * sin(current.pose.z * (CV_PI / 180)));
-
-            neighbour.pose.z = (int) (sz - (90 - current.pose.z));
-            neighbour.h_dist = 0;
-            neighbour.seed_id = i;
-            neighbour.g_dist = seeds[i].cost;
-            neighbour.h_obs = 0;
-            neighbour.g_obs = 0;
-
-            neighbours.push_back(neighbour);
-        }
-
-        return neighbours;
+    /// Fills neighbours with the successors of current, reusing its storage
+    void neighborNodes(const state& current, vector<state>& neighbours) {
+        main_workspace.neighborNodes(current, neighbours);
     }
 
-    bool onTarget(state current, state goal) {
-        for (unsigned int i = 0; i < seeds.size(); i++) {
-            for (unsigned int j = 0; j < seeds[i].seed_points.size(); j++) {
-                state temp;
-                double sx = seeds[i].seed_points[j].x;
-                double sy = seeds[i].dest.y;
-                double sz = seeds[i].dest.z;
-
-                temp.pose.x = (int) (current.pose.x +
-                        sx * sin(current.pose.z * (CV_PI / 180)) +
-                        sy * cos(current.pose.z * (CV_PI / 180)));
-                temp.pose.y = (int) (current.pose.y +
-                        -sx * cos(current.pose.z * (CV_PI / 180)) +
-                        sy * sin(current.pose.z * (CV_PI / 180)));
-
-                if (isEqual(temp, goal)) {
-                    return true;
-                }
-            }
-        }
-        return false;
+    /// Does some seed from current sweep a cell of the goal region
+    bool onTarget(const state& current, const GoalRegion& goal) {
+        return main_workspace.onTarget(current, goal);
     }
 
     void print(state s) {
@@ -609,27 +648,7 @@ namespace planner_space {
     }
 
     bool isWalkable(state parent, state s) {
-        int flag = 1;
-
-        for (unsigned int i = 0; i < seeds[s.seed_id].seed_points.size(); i++) {
-            int x, y;
-            double alpha = parent.pose.z;
-
-            int tx, ty;
-            tx = seeds[s.seed_id].seed_points[i].x;
-            ty = seeds[s.seed_id].seed_points[i].y;
-
-            x = (int) (tx * sin(alpha * (CV_PI / 180)) + ty * cos(alpha * (CV_PI / 180)) + parent.pose.x);
-            y = (int) (-tx * cos(alpha * (CV_PI / 180)) + ty * sin(alpha * (CV_PI / 180)) + parent.pose.y);
-
-            if (((0 <= x) && (x < MAP_MAX)) && ((0 <= y) && (y < MAP_MAX))) {
-                local_map[x][y] == 0 ? flag *= 1 : flag *= 0;
-            } else {
-                return false;
-            }
-        }
-
-        return flag == 1;
+        return main_workspace.isWalkable(parent, s);
     }
 
     void closePlanner() {
@@ -652,3 +671,5 @@ namespace planner_space {
 #endif
     }
 }
+
+#endif
@@ -0,0 +1,144 @@
+#ifndef _PLANNER_OCCUPANCY_H_
+#define _PLANNER_OCCUPANCY_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include "../../eklavya2.h"
+
+/**
+ * Extra inflation of the planner map, in cells (square footprint).
+ * The lidar map is already dilated for the bot in LidarData, so this only
+ * matters for obstacles that arrive uninflated (lanes).
+ */
+#define OCCUPANCY_INFLATION 0
+
+#define OCCUPANCY_WORD_BITS 64
+// One spare word per row so a 64 cell window can always read two words
+#define OCCUPANCY_ROW_WORDS ((MAP_MAX + OCCUPANCY_WORD_BITS - 1) / OCCUPANCY_WORD_BITS + 1)
+
+namespace planner_space {
+
+    /**
+     * Bit-packed C-space occupancy of the planner map, one bit per cell.
+     * Row x holds cells (x, 0..MAP_MAX-1) with y along the bits, so a seed's
+     * swept cells in one row are tested with a single AND (see SeedTable spans).
+     * The whole grid is about 133 KB against 1 MB for the byte map.
+     */
+    class OccupancyGrid {
+    public:
+
+        OccupancyGrid() {
+            memset(words, 0, sizeof (words));
+        }
+
+        /// Packs a byte map, any non zero cell is occupied
+        void pack(char **map) {
+            memset(words, 0, sizeof (words));
+
+            for (int x = 0; x < MAP_MAX; x++) {
+                uint64_t *row = words[x];
+                for (int y = 0; y < MAP_MAX; y++) {
+                    if (map[x][y] != 0) {
+                        row[y / OCCUPANCY_WORD_BITS] |= (uint64_t) 1 << (y % OCCUPANCY_WORD_BITS);
+                    }
+                }
+            }
+
+            if (OCCUPANCY_INFLATION > 0) {
+                inflate(OCCUPANCY_INFLATION);
+            }
+        }
+
+        bool occupied(int x, int y) const {
+            return (words[x][y / OCCUPANCY_WORD_BITS] >> (y % OCCUPANCY_WORD_BITS)) & 1;
+        }
+
+        /// Frees the cells within r of (cx, cy) that lie on the map
+        void clearDisk(int cx, int cy, int r) {
+            for (int x = max(0, cx - r); x <= min(MAP_MAX - 1, cx + r); x++) {
+                int h = (int) sqrt((double) (r * r - (x - cx) * (x - cx)));
+                for (int y = max(0, cy - h); y <= min(MAP_MAX - 1, cy + h); y++) {
+                    words[x][y / OCCUPANCY_WORD_BITS] &= ~((uint64_t) 1 << (y % OCCUPANCY_WORD_BITS));
+                }
+            }
+        }
+
+        /// Cells (x, y) .. (x, y + 63) as bits 0..63, 0 <= y < MAP_MAX
+        uint64_t window(int x, int y) const {
+            const uint64_t *row = words[x];
+            int w = y / OCCUPANCY_WORD_BITS;
+            int shift = y % OCCUPANCY_WORD_BITS;
+
+            if (shift == 0) {
+                return row[w];
+            }
+            return (row[w] >> shift) | (row[w + 1] << (OCCUPANCY_WORD_BITS - shift));
+        }
+
+    private:
+
+        /// Square dilation, along the bits of each row and then across rows
+        void inflate(int r) {
+            static uint64_t spread[MAP_MAX][OCCUPANCY_ROW_WORDS];
+
+            for (int x = 0; x < MAP_MAX; x++) {
+                uint64_t *row = words[x];
+                uint64_t *out = spread[x];
+                memcpy(out, row, sizeof (words[x]));
+
+                for (int s = 1; s <= r; s++) {
+                    int ws = s / OCCUPANCY_WORD_BITS;
+                    int bs = s % OCCUPANCY_WORD_BITS;
+
+                    for (int w = 0; w < OCCUPANCY_ROW_WORDS; w++) {
+                        // row shifted by +s and by -s cells
+                        uint64_t up = 0, down = 0;
+                        if (w - ws >= 0) {
+                            up = row[w - ws] << bs;
+                            if (bs && w - ws - 1 >= 0) {
+                                up |= row[w - ws - 1] >> (OCCUPANCY_WORD_BITS - bs);
+                            }
+                        }
+                        if (w + ws < OCCUPANCY_ROW_WORDS) {
+                            down = row[w + ws] >> bs;
+                            if (bs && w + ws + 1 < OCCUPANCY_ROW_WORDS) {
+                                down |= row[w + ws + 1] << (OCCUPANCY_WORD_BITS - bs);
+                            }
+                        }
+                        out[w] |= up | down;
+                    }
+                }
+            }
+
+            for (int x = 0; x < MAP_MAX; x++) {
+                int lo = x - r < 0 ? 0 : x - r;
+                int hi = x + r >= MAP_MAX ? MAP_MAX - 1 : x + r;
+
+                for (int w = 0; w < OCCUPANCY_ROW_WORDS; w++) {
+                    uint64_t v = 0;
+                    for (int i = lo; i <= hi; i++) {
+                        v |= spread[i][w];
+                    }
+                    words[x][w] = v;
+                }
+            }
+
+            // Keep the cells past the map edge free
+            int tail = MAP_MAX % OCCUPANCY_WORD_BITS;
+            for (int x = 0; x < MAP_MAX; x++) {
+                if (tail) {
+                    words[x][MAP_MAX / OCCUPANCY_WORD_BITS] &= ((uint64_t) 1 << tail) - 1;
+                }
+                for (int w = (MAP_MAX + OCCUPANCY_WORD_BITS - 1) / OCCUPANCY_WORD_BITS; w < OCCUPANCY_ROW_WORDS; w++) {
+                    words[x][w] = 0;
+                }
+            }
+        }
+
+        uint64_t words[MAP_MAX][OCCUPANCY_ROW_WORDS];
+    };
+}
+
+#endif
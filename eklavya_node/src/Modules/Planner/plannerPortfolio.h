@@ -0,0 +1,274 @@
+#ifndef _PLANNER_PORTFOLIO_H_
+#define _PLANNER_PORTFOLIO_H_
+
+#include <errno.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include "plannerSearch.h"
+
+/**
+ * Portfolio planning: every configuration in portfolio_configs searches the
+ * same map on its own thread. The first path found wins; with
+ * PORTFOLIO_WAIT_BEST the cheapest one found by PORTFOLIO_DEADLINE seconds
+ * does. The others are cancelled at their next check.
+ *
+ * Like findPath(), each worker first searches the coarse corridor when the
+ * caller planned one, and the whole map if the corridor holds no path.
+ */
+#define PORTFOLIO_DEADLINE 0.08
+//#define PORTFOLIO_WAIT_BEST
+
+namespace planner_space {
+
+    typedef struct portfolio_config {
+        const char *seeds_file;
+        const char *heuristic_file; // euclidean distance if missing, see heuristic_generator
+        bool clearance; // ClearanceCost on the cost field, else path length
+        double weight; // heuristic inflation of a path length search, 1 keeps paths optimal
+    } portfolio_config;
+
+    static const portfolio_config portfolio_configs[] = {
+        {"../src/Modules/Planner/seeds2.txt", "../src/Modules/Planner/heuristic2.lut", false, 1.0},
+        {"../src/Modules/Planner/seeds2.txt", "../src/Modules/Planner/heuristic2.lut", true, 1.0},
+        {"../src/Modules/Planner/seeds2.txt", "../src/Modules/Planner/heuristic2.lut", false, 2.0},
+        {"../src/Modules/Planner/seeds4.txt", "../src/Modules/Planner/heuristic4.lut", false, 1.5},
+        {"../src/Modules/Planner/seeds5.txt", "../src/Modules/Planner/heuristic5.lut", false, 1.5}
+    };
+
+#define PORTFOLIO_SIZE ((int) (sizeof (portfolio_configs) / sizeof (portfolio_configs[0])))
+
+    class Portfolio;
+
+    /// One configuration, its seed set and the thread searching with it
+    typedef struct portfolio_worker {
+        portfolio_config config;
+        vector<seed> seeds;
+        SeedTable seed_table;
+        HeuristicTable heuristic_table;
+        SearchWorkspace workspace;
+
+        Portfolio *portfolio;
+        pthread_t thread;
+        unsigned int job; // last job taken
+        SearchStatus status;
+        int goal_node;
+    } portfolio_worker;
+
+    /**
+     * Workers and their workspaces are set up by start(), on the first
+     * portfolio search. Each workspace takes the memory of the planner's own
+     * (nodes of MAX_ITER expansions plus their lattice index), so a portfolio of PORTFOLIO_SIZE
+     * costs that many times as much.
+     *
+     * Workers only read the map state (occupancy, cost field, goal region,
+     * coarse corridor, local_map), so plan() does not return before every
+     * worker has stopped; the caller may then update the map.
+     */
+    class Portfolio {
+    public:
+
+        Portfolio() : job(0), started(false), finished(0), found(0) {
+            pthread_mutex_init(&mutex, NULL);
+            pthread_cond_init(&job_posted, NULL);
+            pthread_cond_init(&job_done, NULL);
+        }
+
+        /// Loads every configuration and starts its worker, false if none could be loaded
+        bool start() {
+            started = true;
+
+            for (int i = 0; i < PORTFOLIO_SIZE; i++) {
+                portfolio_worker *w = new portfolio_worker;
+                w->config = portfolio_configs[i];
+                w->portfolio = this;
+                w->job = 0;
+
+                if (!loadSeeds(w->config.seeds_file, w->seeds)) {
+                    ROS_WARN("[PLANNER] Portfolio: unable to open %s, configuration %d disabled", w->config.seeds_file, i);
+                    delete w;
+                    continue;
+                }
+                w->seed_table.build(w->seeds);
+                if (!w->heuristic_table.load(w->config.heuristic_file, w->seeds)) {
+                    ROS_WARN("[PLANNER] Portfolio: no heuristic table for %s, using euclidean distance", w->config.seeds_file);
+                }
+
+                w->workspace.bind(w->seeds, w->seed_table, w->heuristic_table, occupancy);
+                w->workspace.allocate(MAX_ITER);
+
+                if (pthread_create(&w->thread, NULL, &Portfolio::run, w) != 0) {
+                    ROS_ERROR("[PLANNER] Portfolio: unable to start worker %d", i);
+                    delete w;
+                    continue;
+                }
+                pthread_detach(w->thread);
+                workers.push_back(w);
+            }
+
+            ROS_INFO("[PLANNER] Portfolio of %d configurations started", (int) workers.size());
+            return !workers.empty();
+        }
+
+        bool ready() const {
+            return started;
+        }
+
+        /**
+         * Searches from start to the global goal_region with every worker.
+         * Returns the winning worker, -1 if none found a path; then status
+         * holds the most telling failure.
+         */
+        int plan(const state& start, Triplet target, cv::Mat data_img, bool corridor, SearchStatus *status) {
+            pthread_mutex_lock(&mutex);
+
+            job_start = start;
+            job_target = target;
+            job_img = data_img;
+            job_corridor = corridor;
+            finished = 0;
+            found = 0;
+            for (unsigned int i = 0; i < workers.size(); i++) {
+                workers[i]->workspace.cancelled = 0;
+            }
+            job++;
+            pthread_cond_broadcast(&job_posted);
+
+            struct timespec deadline = deadlineFromNow(PORTFOLIO_DEADLINE);
+            while (finished < (int) workers.size()) {
+#ifndef PORTFOLIO_WAIT_BEST
+                if (found > 0) {
+                    break;
+                }
+#endif
+                if (pthread_cond_timedwait(&job_done, &mutex, &deadline) == ETIMEDOUT) {
+                    break;
+                }
+            }
+
+            for (unsigned int i = 0; i < workers.size(); i++) {
+                workers[i]->workspace.cancelled = 1;
+            }
+            while (finished < (int) workers.size()) {
+                pthread_cond_wait(&job_done, &mutex);
+            }
+
+            pthread_mutex_unlock(&mutex);
+
+            int best = -1;
+            *status = SearchOverflow;
+            for (unsigned int i = 0; i < workers.size(); i++) {
+                const portfolio_worker *w = workers[i];
+                if (w->status == SearchPathFound) {
+                    if (best == -1 || w->workspace.stats.path_cost < workers[best]->workspace.stats.path_cost) {
+                        best = i;
+                    }
+                } else if (w->status == SearchStartBlocked || (w->status == SearchNoPath && *status != SearchStartBlocked)) {
+                    *status = w->status;
+                }
+            }
+            if (best != -1) {
+                *status = SearchPathFound;
+            }
+
+            return best;
+        }
+
+        const portfolio_worker& worker(int i) const {
+            return *workers[i];
+        }
+
+    private:
+
+        static void *run(void *arg) {
+            portfolio_worker *w = (portfolio_worker *) arg;
+            Portfolio *p = w->portfolio;
+
+            while (true) {
+                pthread_mutex_lock(&p->mutex);
+                while (w->job == p->job) {
+                    pthread_cond_wait(&p->job_posted, &p->mutex);
+                }
+                w->job = p->job;
+                state start = p->job_start;
+                Triplet target = p->job_target;
+                cv::Mat data_img = p->job_img;
+                bool corridor = p->job_corridor;
+                pthread_mutex_unlock(&p->mutex);
+
+                SearchStatus status = SearchNoPath;
+#ifdef COARSE_CORRIDOR
+                if (corridor) {
+                    status = searchCorridor(w, start, target, data_img);
+                }
+#endif
+                if (status == SearchNoPath) {
+                    status = search(w, start, target, data_img);
+                }
+
+                pthread_mutex_lock(&p->mutex);
+                w->status = status;
+                w->workspace.stats.path_cost = status == SearchPathFound ? w->workspace.nodes[w->goal_node].s.g_dist : -1;
+                p->finished++;
+                if (status == SearchPathFound) {
+                    p->found++;
+                }
+                pthread_cond_broadcast(&p->job_done);
+                pthread_mutex_unlock(&p->mutex);
+            }
+
+            return NULL;
+        }
+
+        static SearchStatus search(portfolio_worker *w, const state& start, Triplet target, cv::Mat data_img) {
+            LatticeHeuristic h(target);
+
+            if (w->config.clearance) {
+                ClearanceSearch search(w->workspace, ClearanceCost(target), h, LatticeSuccessors(), LatticeCollision());
+                return search.run(start, data_img, &w->goal_node);
+            }
+
+            WeightedSearch search(w->workspace, WeightedLengthCost(w->config.weight), h, LatticeSuccessors(), LatticeCollision());
+            return search.run(start, data_img, &w->goal_node);
+        }
+
+        static SearchStatus searchCorridor(portfolio_worker *w, const state& start, Triplet target, cv::Mat data_img) {
+            CorridorHeuristic h(target);
+
+            if (w->config.clearance) {
+                ClearanceCorridorSearch search(w->workspace, ClearanceCost(target), h, LatticeSuccessors(), CorridorCollision());
+                return search.run(start, data_img, &w->goal_node);
+            }
+
+            WeightedCorridorSearch search(w->workspace, WeightedLengthCost(w->config.weight), h, LatticeSuccessors(), CorridorCollision());
+            return search.run(start, data_img, &w->goal_node);
+        }
+
+        static struct timespec deadlineFromNow(double seconds) {
+            struct timeval now;
+            gettimeofday(&now, NULL);
+
+            long nsec = now.tv_usec * 1000 + (long) (seconds * 1e9);
+            struct timespec t;
+            t.tv_sec = now.tv_sec + nsec / 1000000000;
+            t.tv_nsec = nsec % 1000000000;
+            return t;
+        }
+
+        vector<portfolio_worker *> workers;
+
+        pthread_mutex_t mutex; // guards the job and the counters below
+        pthread_cond_t job_posted, job_done;
+        unsigned int job; // generation, workers wait for it to change
+        state job_start;
+        Triplet job_target;
+        cv::Mat job_img;
+        bool job_corridor; // coarse_grid holds a corridor for this job
+
+        bool started;
+        int finished, found; // workers done with the current job, and those that found a path
+    };
+
+    Portfolio portfolio;
+}
+
+#endif
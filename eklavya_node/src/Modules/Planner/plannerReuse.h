@@ -0,0 +1,208 @@
+#ifndef _PLANNER_REUSE_H_
+#define _PLANNER_REUSE_H_
+
+#include <algorithm>
+#include "planner.h"
+#include "plannerSeedTable.h"
+#include "plannerOccupancy.h"
+
+/**
+ * The path of the last search is followed again while it stays free, still
+ * reaches the target and the bot stays on it: within REUSE_MAX_OFFSET cells
+ * of the step it is on, heading within REUSE_MAX_HEADING degrees of it.
+ * Every REUSE_MAX_CYCLES cycles the planner searches anyway, to pick up
+ * better paths the map may have opened since.
+ */
+#define REUSE_MAX_OFFSET 10
+#define REUSE_MAX_HEADING 20
+#define REUSE_MAX_CYCLES 10
+
+namespace planner_space {
+
+    typedef struct path_step { // one seed of a recorded path
+        Triplet from; // pose the seed starts at, in the frame of the recording
+        int seed_id;
+        double cost;
+    } path_step;
+
+    /**
+     * A found path kept in the map frame of the cycle that found it, and the
+     * rigid motion from that frame to the current one. Map cells of the path
+     * are moved into the current frame only when they are checked. The bot
+     * has the same map pose in every frame (bot_location), only the world
+     * around it moves.
+     */
+    class PathReuse {
+    public:
+
+        PathReuse() : seeds(NULL), seed_table(NULL), recorded(false) {
+            clear();
+        }
+
+        void clear() {
+            steps.clear();
+            recorded = false;
+        }
+
+        /// Adds a step of the path being recorded, from the goal back to the bot
+        void addStep(Triplet from, int seed_id, double cost) {
+            path_step step;
+            step.from = from;
+            step.seed_id = seed_id;
+            step.cost = cost;
+            steps.push_back(step);
+        }
+
+        /**
+         * Completes the path added by addStep(), found from bot to end in the
+         * current frame with seed_set, which must outlive the recording.
+         */
+        void record(Triplet bot, Triplet end, const vector<seed>& seed_set, const SeedTable& table) {
+            reverse(steps.begin(), steps.end());
+            seeds = &seed_set;
+            seed_table = &table;
+            origin = bot;
+            goal = end;
+            phi = 0;
+            shift_x = shift_y = 0;
+            moved = false;
+            cycles = 0;
+            recorded = !steps.empty();
+        }
+
+        /// The bot moved by motion (see EgoMotion) since the last call
+        void move(TripletFP motion) {
+            if (!recorded) {
+                return;
+            }
+
+            // Points fixed in the world turn the other way in the bot frame
+            double a = -motion.z * CV_PI / 180;
+            double x = shift_x - motion.x;
+            double y = shift_y - motion.y;
+            shift_x = x * cos(a) - y * sin(a);
+            shift_y = x * sin(a) + y * cos(a);
+            phi += a;
+
+            moved = true;
+            cycles++;
+        }
+
+        /**
+         * First step to follow from bot, -1 if the path can not be reused.
+         * cost is set to the seed cost of the rest of the path. Whether the
+         * path still ends in the goal region is left to the caller, see end().
+         */
+        int follow(Triplet bot, const OccupancyGrid& occupancy, double *cost) {
+            // Without a motion estimate the path could be anywhere
+            if (!recorded || !moved || cycles > REUSE_MAX_CYCLES) {
+                return -1;
+            }
+
+            double a = bot.z * CV_PI / 180;
+            int first = -1;
+            for (int i = 0; i < (int) steps.size() && first == -1; i++) {
+                Triplet p = stepEnd(i, bot);
+                if ((p.x - bot.x) * cos(a) + (p.y - bot.y) * sin(a) > 0) {
+                    first = i;
+                }
+            }
+            if (first == -1) {
+                return -1;
+            }
+
+            if (!onStep(first, bot)) {
+                return -1;
+            }
+
+            *cost = 0;
+            for (int i = first; i < (int) steps.size(); i++) {
+                const seed_entry& e = seed_table->entry(steps[i].from.z, steps[i].seed_id);
+                for (int k = e.swept_begin; k < e.swept_end; k++) {
+                    const cell_offset& c = seed_table->sweptCell(k);
+                    Triplet t = current(steps[i].from.x + c.x, steps[i].from.y + c.y, 0, bot);
+                    if (!(((t.x >= 0) && (t.x < MAP_MAX)) && ((t.y >= 0) && (t.y < MAP_MAX)))) {
+                        return -1;
+                    }
+                    if (occupancy.occupied(t.x, t.y)) {
+                        return -1;
+                    }
+                }
+                *cost += steps[i].cost;
+            }
+
+            return first;
+        }
+
+        int size() const {
+            return steps.size();
+        }
+
+        /// Seed of step i, from the set the path was found with
+        const seed& stepSeed(int i) const {
+            return (*seeds)[steps[i].seed_id];
+        }
+
+        /// Pose step i ends at, in the current frame of a bot at bot
+        Triplet stepEnd(int i, Triplet bot) const {
+            const Triplet& p = i + 1 < (int) steps.size() ? steps[i + 1].from : goal;
+            return current(p.x, p.y, p.z, bot);
+        }
+
+        /// Last pose of the path, in the current frame
+        Triplet end(Triplet bot) const {
+            return current(goal.x, goal.y, goal.z, bot);
+        }
+
+    private:
+
+        Triplet current(double x, double y, double z, Triplet bot) const {
+            double rx = x - origin.x;
+            double ry = y - origin.y;
+
+            Triplet t;
+            t.x = (int) floor(bot.x + rx * cos(phi) - ry * sin(phi) + shift_x + 0.5);
+            t.y = (int) floor(bot.y + rx * sin(phi) + ry * cos(phi) + shift_y + 0.5);
+            t.z = (int) floor(z + phi * 180 / CV_PI + 0.5);
+            return t;
+        }
+
+        static int angleDiff(int a, int b) {
+            return ((a - b) % 360 + 540) % 360 - 180;
+        }
+
+        /// Is the bot close to step i and heading the way the step turns
+        bool onStep(int i, Triplet bot) const {
+            Triplet from = current(steps[i].from.x, steps[i].from.y, steps[i].from.z, bot);
+            Triplet to = stepEnd(i, bot);
+
+            int d_from = angleDiff(bot.z, from.z);
+            int d_to = angleDiff(bot.z, to.z);
+            bool between = (d_from <= 0 && d_to >= 0) || (d_from >= 0 && d_to <= 0);
+            if (!between && abs(d_from) > REUSE_MAX_HEADING && abs(d_to) > REUSE_MAX_HEADING) {
+                return false;
+            }
+
+            int best = (from.x - bot.x) * (from.x - bot.x) + (from.y - bot.y) * (from.y - bot.y);
+            const seed_entry& e = seed_table->entry(steps[i].from.z, steps[i].seed_id);
+            for (int k = e.swept_begin; k < e.swept_end; k++) {
+                const cell_offset& c = seed_table->sweptCell(k);
+                Triplet t = current(steps[i].from.x + c.x, steps[i].from.y + c.y, 0, bot);
+                best = min(best, (t.x - bot.x) * (t.x - bot.x) + (t.y - bot.y) * (t.y - bot.y));
+            }
+
+            return best <= REUSE_MAX_OFFSET * REUSE_MAX_OFFSET;
+        }
+
+        vector<path_step> steps; // from the bot to the goal once recorded
+        const vector<seed> *seeds; // the path was found with
+        const SeedTable *seed_table;
+        Triplet origin, goal; // bot and last pose in the recording frame
+        double phi; // rotation from the recording frame to the current one, radians
+        double shift_x, shift_y; // translation, applied after the rotation
+        bool recorded, moved;
+        int cycles; // since the recording
+    };
+}
+
+#endif
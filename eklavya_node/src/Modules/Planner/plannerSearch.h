@@ -0,0 +1,347 @@
+#ifndef _PLANNER_SEARCH_H_
+#define _PLANNER_SEARCH_H_
+
+#include "plannerMethods.h"
+
+/// Expansions between two looks at SearchWorkspace::cancelled
+#define SEARCH_CANCEL_CHECK 64
+
+namespace planner_space {
+
+    enum SearchStatus {
+        SearchPathFound,
+        SearchNoPath,
+        SearchOverflow, // MAX_ITER expansions without reaching the target
+        SearchStartBlocked,
+        SearchCancelled // SearchWorkspace::cancelled was set
+    };
+
+    /**
+     * Search policies. A search is specialized on one type of each kind at
+     * compile time, so the policies are inlined into the loop. Seeds and
+     * counters come from the search's workspace:
+     *
+     * Cost:       void step(const state& parent, state& s), s arrives with
+     *             g_dist accumulated and h_dist set, adds any other terms;
+     *             double key(const state& s), the open list key.
+     * Heuristic:  double operator()(const SearchWorkspace& ws, Triplet pose),
+     *             cost-to-go estimate.
+     * Successors: void operator()(const SearchWorkspace& ws, const state& s,
+     *             vector<state>& out), out[i].g_dist holds the edge cost.
+     * Collision:  bool inside(const state& s), does s lie on the map;
+     *             bool operator()(SearchWorkspace& ws, const state& parent,
+     *             const state& s), is the seed from parent to s free;
+     *             static const bool lazy, defer that check until s is popped.
+     */
+
+    /// Path length only (findPath)
+    struct LengthCost {
+
+        void step(const state& parent, state& s) {
+        }
+
+        double key(const state& s) {
+            return s.g_dist + s.h_dist;
+        }
+    };
+
+    /// Path length with the heuristic inflated by weight, paths cost at most weight times the best
+    struct WeightedLengthCost {
+
+        WeightedLengthCost(double weight) : weight(weight) {
+        }
+
+        void step(const state& parent, state& s) {
+        }
+
+        double key(const state& s) {
+            return s.g_dist + weight * s.h_dist;
+        }
+
+        double weight;
+    };
+
+    /// Path length plus the Voronoi/DT clearance field, scaled to the distance to go (findPathDT)
+    struct ClearanceCost {
+
+        ClearanceCost(Triplet target) {
+            vdt_goal = cost_field.at(target.x, target.y);
+            vdt_max = cost_field.maxDistance();
+        }
+
+        void step(const state& parent, state& s) {
+            double vdt = cost_field.at(s.pose.x, s.pose.y);
+            double scaling_factor = s.h_dist / (2 * vdt_max + vdt_goal);
+
+            s.g_obs = vdt * scaling_factor;
+            s.h_obs = (vdt + vdt_goal) / 2 * scaling_factor;
+            s.depth = parent.depth + 1;
+        }
+
+        double key(const state& s) {
+            return s.g_dist + s.h_dist + s.g_obs + s.h_obs;
+        }
+
+        double vdt_goal, vdt_max;
+    };
+
+    struct LatticeHeuristic {
+
+        LatticeHeuristic(Triplet target) : target(target) {
+        }
+
+        double operator()(const SearchWorkspace& ws, Triplet pose) {
+            return ws.heuristic(pose, target);
+        }
+
+        Triplet target;
+    };
+
+    struct LatticeSuccessors {
+
+        void operator()(const SearchWorkspace& ws, const state& s, vector<state>& out) {
+            ws.neighborNodes(s, out);
+        }
+    };
+
+    struct SweptCollision {
+        static const bool lazy = false;
+
+        bool inside(const state& s) {
+            return ((s.pose.x >= 0) && (s.pose.x < MAP_MAX)) &&
+                    ((s.pose.y >= 0) && (s.pose.y < MAP_MAX));
+        }
+
+        bool operator()(SearchWorkspace& ws, const state& parent, const state& s) {
+            return ws.isWalkable(parent, s);
+        }
+    };
+
+    /**
+     * Same test, run when the end node of a seed is popped. Most generated
+     * nodes never are, so most seeds are never checked. Results are cached
+     * per parent node and seed (lattice_node::edge_checked / edge_free) for
+     * the rest of the query. Needs at most 64 seeds.
+     */
+    struct LazySweptCollision : public SweptCollision {
+        static const bool lazy = true;
+    };
+
+#ifdef LAZY_COLLISION
+    typedef LazySweptCollision LatticeCollision;
+#else
+    typedef SweptCollision LatticeCollision;
+#endif
+
+    /// LatticeHeuristic raised to the coarse path length where the last CoarseGrid::plan() knows it, inadmissible
+    struct CorridorHeuristic : public LatticeHeuristic {
+
+        CorridorHeuristic(Triplet target) : LatticeHeuristic(target) {
+        }
+
+        double operator()(const SearchWorkspace& ws, Triplet pose) {
+            return max(ws.heuristic(pose, target), coarse_grid.costEstimate(pose.x, pose.y));
+        }
+    };
+
+    /// LatticeCollision, with nodes outside the coarse corridor treated as off the map
+    struct CorridorCollision : public LatticeCollision {
+
+        bool inside(const state& s) {
+            return LatticeCollision::inside(s) && coarse_grid.inCorridor(s.pose.x, s.pose.y);
+        }
+    };
+
+    /**
+     * LatticeCollision on dynamic_occupancy, and against where the moving
+     * obstacles will be while the seed is driven. Seed times come from the
+     * path length to the parent, so a node keeps the time of its cheapest
+     * way in.
+     */
+    struct DynamicCollision : public LatticeCollision {
+
+        bool operator()(SearchWorkspace& ws, const state& parent, const state& s) {
+            if (!ws.isWalkable(parent, s, dynamic_occupancy)) {
+                return false;
+            }
+
+            double t0 = parent.g_dist / DYNAMIC_BOT_SPEED;
+            double t1 = t0 + (*ws.seeds)[s.seed_id].cost / DYNAMIC_BOT_SPEED;
+            const seed_entry& e = ws.seed_table->entry(parent.pose.z, s.seed_id);
+            return !obstacle_prediction.blocks(*ws.seed_table, e, parent.pose.x, parent.pose.y, t0, t1);
+        }
+    };
+
+    /**
+     * A* over the lattice node pool towards goal_region, stopping at the first
+     * node that is in the goal region or sweeps it. findPath and findPathDT
+     * are this loop with different policies.
+     *
+     * All search state lives in the workspace; run() checks its cancelled
+     * flag every SEARCH_CANCEL_CHECK expansions.
+     *
+     * With a lazy collision policy a node's seed from its parent may still be
+     * unchecked while it is open. That seed is checked as soon as another
+     * parent competes for the node and before the node is expanded, so the
+     * search finds the same nodes, costs and paths as with eager checks.
+     */
+    template <class Cost, class Heuristic, class Successors, class Collision>
+    class LatticeSearch {
+    public:
+
+        LatticeSearch(SearchWorkspace& ws, Cost cost, Heuristic h, Successors successors, Collision collision) :
+        ws(ws), nodes(ws.nodes), open_list(ws.open_list), cost(cost), h(h), expand(successors), walkable(collision) {
+        }
+
+        SearchStatus run(state start, cv::Mat data_img, int *goal_node) {
+            ws.reset();
+
+            //TODO: This condition needs to be handled in the strategy module.
+            if (local_map[start.pose.x][start.pose.y] > 0) {
+                return SearchStartBlocked;
+            }
+
+            start.seed_id = -1;
+            start.g_dist = 0;
+            start.h_dist = h(ws, start.pose);
+            start.g_obs = 0;
+            start.h_obs = 0;
+            start.depth = 0;
+            open_list.push(ws.addNode(start, -1), cost.key(start));
+
+            int iterations = 0;
+            while (!open_list.empty()) {
+                if ((iterations % SEARCH_CANCEL_CHECK == 0) && ws.cancelled) {
+                    return SearchCancelled;
+                }
+
+                int current_node = open_list.top();
+
+                if (Collision::lazy && !reachable(current_node)) {
+                    // Blocked seed, the node can still be found from another parent
+                    open_list.pop();
+                    nodes[current_node].membership = UNASSIGNED;
+                    continue;
+                }
+
+                state current = nodes[current_node].s;
+
+#ifdef DEBUG
+                cout << "==> CURRENT: ";
+                print(current);
+
+                plotPoint(data_img, current.pose);
+                cv::imshow("[PLANNER] Map", data_img);
+
+                cvWaitKey(0);
+#endif
+
+                if (isEqual(current, goal_region) || ws.onTarget(current, goal_region)) {
+                    *goal_node = current_node;
+                    return SearchPathFound;
+                }
+
+                ws.countExpansion();
+                open_list.pop();
+                nodes[current_node].membership = CLOSED;
+
+                expand(ws, current, ws.successors);
+
+                for (unsigned int i = 0; i < ws.successors.size(); i++) {
+                    state neighbor = ws.successors[i];
+
+                    if (!walkable.inside(neighbor)) {
+                        continue;
+                    }
+
+                    if (!Collision::lazy && !walkable(ws, current, neighbor)) {
+                        continue;
+                    }
+
+                    neighbor.g_dist += current.g_dist;
+                    neighbor.h_dist = h(ws, neighbor.pose);
+                    cost.step(current, neighbor);
+
+                    if (Collision::lazy) {
+                        relaxLazy(neighbor, current_node, cost.key(neighbor));
+                    } else {
+                        ws.relaxNode(neighbor, current_node, cost.key(neighbor));
+                    }
+                }
+
+                iterations++;
+                if (iterations > MAX_ITER) {
+                    return SearchOverflow;
+                }
+            }
+
+            return SearchNoPath;
+        }
+
+    private:
+
+        /// Is the seed from parent to s free, checked once per parent and seed
+        bool edgeFree(int parent, const state& s) {
+            uint64_t bit = (uint64_t) 1 << s.seed_id;
+
+            if (!(nodes[parent].edge_checked & bit)) {
+                nodes[parent].edge_checked |= bit;
+                if (walkable(ws, nodes[parent].s, s)) {
+                    nodes[parent].edge_free |= bit;
+                }
+            }
+            return nodes[parent].edge_free & bit;
+        }
+
+        bool reachable(int n) {
+            return nodes[n].parent == -1 || edgeFree(nodes[n].parent, nodes[n].s);
+        }
+
+        /// relaxNode() with the seed from parent left unchecked where no other parent competes
+        void relaxLazy(const state& s, int parent, double f) {
+            int n = ws.findNode(s.pose);
+
+            if (n == -1) {
+                open_list.push(ws.addNode(s, parent), f);
+                return;
+            }
+
+            if (nodes[n].membership == UNASSIGNED) {
+                // Its previous way in was blocked
+                nodes[n].s = s;
+                nodes[n].parent = parent;
+                nodes[n].membership = OPEN;
+                open_list.push(n, f);
+                return;
+            }
+
+            if (nodes[n].membership != OPEN) {
+                return;
+            }
+
+            if (!reachable(n) || ((s.g_dist < nodes[n].s.g_dist) && edgeFree(parent, s))) {
+                nodes[n].s = s;
+                nodes[n].parent = parent;
+                open_list.update(n, f);
+            }
+        }
+
+        SearchWorkspace& ws;
+        vector<lattice_node>& nodes;
+        IndexedHeap<double>& open_list;
+        Cost cost;
+        Heuristic h;
+        Successors expand;
+        Collision walkable;
+    };
+
+    typedef LatticeSearch<LengthCost, LatticeHeuristic, LatticeSuccessors, LatticeCollision> PlainSearch;
+    typedef LatticeSearch<WeightedLengthCost, LatticeHeuristic, LatticeSuccessors, LatticeCollision> WeightedSearch;
+    typedef LatticeSearch<LengthCost, LatticeHeuristic, LatticeSuccessors, DynamicCollision> DynamicSearch;
+    typedef LatticeSearch<ClearanceCost, LatticeHeuristic, LatticeSuccessors, LatticeCollision> ClearanceSearch;
+    typedef LatticeSearch<LengthCost, CorridorHeuristic, LatticeSuccessors, CorridorCollision> CorridorSearch;
+    typedef LatticeSearch<WeightedLengthCost, CorridorHeuristic, LatticeSuccessors, CorridorCollision> WeightedCorridorSearch;
+    typedef LatticeSearch<ClearanceCost, CorridorHeuristic, LatticeSuccessors, CorridorCollision> ClearanceCorridorSearch;
+}
+
+#endif
@@ -0,0 +1,164 @@
+#ifndef _PLANNER_SEED_TABLE_H_
+#define _PLANNER_SEED_TABLE_H_
+
+#include <stdint.h>
+#include <algorithm>
+#include "planner.h"
+#include "plannerOccupancy.h"
+
+/**
+ * Angular resolution of the precomputed seed tables, in degrees.
+ * With 1 degree bins the tables reproduce the on-line trigonometry exactly
+ * since bot and seed headings are integral.
+ */
+#define SEED_TABLE_RES 1
+
+/// Rotated offsets this close to an integer are rounding noise of sin/cos
+#define SEED_TABLE_EPS 1e-9
+
+namespace planner_space {
+
+    typedef struct cell_offset {
+        int x, y;
+    } cell_offset;
+
+    typedef struct swept_span { // swept cells (dx, dy + b) for every set bit b of mask
+        int dx, dy;
+        uint64_t mask;
+    } swept_span;
+
+    typedef struct seed_entry { // one seed rotated to one heading bin
+        cell_offset dest;
+        int swept_begin, swept_end; // range of swept cells in SeedTable::swept
+        int span_begin, span_end; // range of row masks in SeedTable::spans
+        cell_offset lo, hi; // bounding box of the swept cells
+    } seed_entry;
+
+    inline bool cellLess(const cell_offset& a, const cell_offset& b) {
+        return a.x < b.x || (a.x == b.x && a.y < b.y);
+    }
+
+    /**
+     * Seed set compiled for every heading bin: successor offsets and the
+     * rasterized cells swept by each seed, relative to the parent pose.
+     * Expanding a node then needs no trigonometry at all. The swept cells are
+     * also packed into per row 64 bit masks for OccupancyGrid::window().
+     */
+    class SeedTable {
+    public:
+
+        SeedTable() : n_seeds(0), n_bins(0) {
+        }
+
+        void build(const vector<seed>& seeds) {
+            n_seeds = seeds.size();
+            n_bins = 360 / SEED_TABLE_RES;
+
+            entries.clear();
+            swept.clear();
+            spans.clear();
+            entries.reserve(n_bins * n_seeds);
+
+            for (int b = 0; b < n_bins; b++) {
+                double alpha = b * SEED_TABLE_RES * (CV_PI / 180);
+                double sin_a = sin(alpha);
+                double cos_a = cos(alpha);
+
+                for (int i = 0; i < n_seeds; i++) {
+                    seed_entry e;
+                    double sx = seeds[i].dest.x;
+                    double sy = seeds[i].dest.y;
+
+                    e.dest.x = (int) floor(sx * sin_a + sy * cos_a + SEED_TABLE_EPS);
+                    e.dest.y = (int) floor(-sx * cos_a + sy * sin_a + SEED_TABLE_EPS);
+
+                    e.swept_begin = swept.size();
+                    for (unsigned int j = 0; j < seeds[i].seed_points.size(); j++) {
+                        // Seed points are truncated to cells before rotation, as isWalkable always did
+                        int tx = seeds[i].seed_points[j].x;
+                        int ty = seeds[i].seed_points[j].y;
+
+                        cell_offset c;
+                        c.x = (int) floor(tx * sin_a + ty * cos_a + SEED_TABLE_EPS);
+                        c.y = (int) floor(-tx * cos_a + ty * sin_a + SEED_TABLE_EPS);
+
+                        bool duplicate = false;
+                        for (unsigned int k = e.swept_begin; k < swept.size(); k++) {
+                            if (swept[k].x == c.x && swept[k].y == c.y) {
+                                duplicate = true;
+                                break;
+                            }
+                        }
+
+                        if (!duplicate) {
+                            swept.push_back(c);
+                        }
+                    }
+                    e.swept_end = swept.size();
+
+                    buildSpans(e);
+                    entries.push_back(e);
+                }
+            }
+        }
+
+        int seedCount() const {
+            return n_seeds;
+        }
+
+        /// Nearest heading bin for a heading in degrees, any range
+        int bin(int z) const {
+            int heading = ((z % 360) + 360) % 360;
+            return ((heading + SEED_TABLE_RES / 2) / SEED_TABLE_RES) % n_bins;
+        }
+
+        const seed_entry& entry(int z, int seed_id) const {
+            return entries[bin(z) * n_seeds + seed_id];
+        }
+
+        const cell_offset& sweptCell(int k) const {
+            return swept[k];
+        }
+
+        const swept_span& span(int k) const {
+            return spans[k];
+        }
+
+    private:
+
+        void buildSpans(seed_entry& e) {
+            vector<cell_offset> cells(swept.begin() + e.swept_begin, swept.begin() + e.swept_end);
+            sort(cells.begin(), cells.end(), cellLess);
+
+            e.lo.x = e.lo.y = e.hi.x = e.hi.y = 0;
+            e.span_begin = spans.size();
+            for (unsigned int k = 0; k < cells.size(); k++) {
+                if (k == 0) {
+                    e.lo = e.hi = cells[k];
+                }
+                e.lo.x = min(e.lo.x, cells[k].x);
+                e.lo.y = min(e.lo.y, cells[k].y);
+                e.hi.x = max(e.hi.x, cells[k].x);
+                e.hi.y = max(e.hi.y, cells[k].y);
+
+                if ((int) spans.size() == e.span_begin || spans.back().dx != cells[k].x ||
+                        cells[k].y - spans.back().dy >= OCCUPANCY_WORD_BITS) {
+                    swept_span sp;
+                    sp.dx = cells[k].x;
+                    sp.dy = cells[k].y;
+                    sp.mask = 0;
+                    spans.push_back(sp);
+                }
+                spans.back().mask |= (uint64_t) 1 << (cells[k].y - spans.back().dy);
+            }
+            e.span_end = spans.size();
+        }
+
+        int n_seeds, n_bins;
+        vector<seed_entry> entries;
+        vector<cell_offset> swept;
+        vector<swept_span> spans;
+    };
+}
+
+#endif
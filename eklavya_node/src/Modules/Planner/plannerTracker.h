@@ -0,0 +1,194 @@
+#ifndef _PLANNER_TRACKER_H_
+#define _PLANNER_TRACKER_H_
+
+#include <math.h>
+#include <pthread.h>
+#include "planner.h"
+
+/**
+ * Pure pursuit on the last published path (PID_MODE 3): every tracker cycle
+ * steers the bot on the arc through the path point TRACKER_LOOKAHEAD cells
+ * ahead of it. Velocities are in sendCommand()'s wheel units (cm/s), so
+ * TRACKER_WHEEL_BASE matches its w.
+ */
+#define TRACKER_LOOKAHEAD 100
+#define TRACKER_SPEED 50 // mean wheel velocity
+#define TRACKER_WHEEL_BASE 55
+#define TRACKER_GOAL_RADIUS 20 // cells, the bot stops this close to the end of the path
+#define TRACKER_MAX_AGE 0.5 // seconds a path is followed without a newer one
+
+namespace planner_space {
+
+    enum TrackerModes {
+        TrackerIdle = 0, // nothing to follow, the bot stands
+        TrackerFollowing = 1,
+        TrackerHolding = 2 // a command of the planner (brake, reverse) until the next path
+    };
+
+    /**
+     * The path is kept in the map frame of the cycle that published it; the
+     * bot's pose in that frame is dead reckoned by move() between cycles.
+     * Called from the planner thread (follow, hold) and the tracker thread
+     * (move, command), all calls lock.
+     */
+    class PathTracker {
+    public:
+
+        PathTracker() : mode(TrackerIdle), progress(0), left(0), right(0) {
+            pthread_mutex_init(&mutex, NULL);
+            points.reserve(64);
+        }
+
+        /// Follows path, found from the bot at bot in the current map frame
+        void follow(const vector<Triplet>& path, Triplet bot) {
+            pthread_mutex_lock(&mutex);
+
+            points.clear();
+            TripletFP p;
+            p.x = bot.x;
+            p.y = bot.y;
+            p.z = bot.z;
+            points.push_back(p);
+            for (unsigned int i = 0; i < path.size(); i++) {
+                p.x = path[i].x;
+                p.y = path[i].y;
+                p.z = path[i].z;
+                points.push_back(p);
+            }
+
+            position = points[0];
+            progress = 0;
+            published = ros::WallTime::now();
+            mode = points.size() > 1 ? TrackerFollowing : TrackerIdle;
+
+            pthread_mutex_unlock(&mutex);
+        }
+
+        /// Drives with the given wheel velocities until the next follow()
+        void hold(int left_vel, int right_vel) {
+            pthread_mutex_lock(&mutex);
+            left = left_vel;
+            right = right_vel;
+            mode = TrackerHolding;
+            pthread_mutex_unlock(&mutex);
+        }
+
+        /// The bot moved by motion (see EgoMotion) since the last call
+        void move(TripletFP motion) {
+            pthread_mutex_lock(&mutex);
+
+            double a = position.z * CV_PI / 180;
+            position.x += motion.y * cos(a) + motion.x * sin(a);
+            position.y += motion.y * sin(a) - motion.x * cos(a);
+            position.z += motion.z;
+
+            pthread_mutex_unlock(&mutex);
+        }
+
+        /// Wheel velocities for now, false if the bot is not following a path
+        bool command(int *left_vel, int *right_vel) {
+            pthread_mutex_lock(&mutex);
+
+            if (mode == TrackerFollowing && (ros::WallTime::now() - published).toSec() > TRACKER_MAX_AGE) {
+                mode = TrackerIdle;
+            }
+
+            if (mode == TrackerFollowing) {
+                TripletFP goal;
+                if (lookahead(&goal)) {
+                    steer(goal, left_vel, right_vel);
+                } else {
+                    mode = TrackerIdle;
+                }
+            }
+
+            if (mode == TrackerHolding) {
+                *left_vel = left;
+                *right_vel = right;
+            } else if (mode == TrackerIdle) {
+                *left_vel = *right_vel = 0;
+            }
+
+            bool following = mode == TrackerFollowing;
+            pthread_mutex_unlock(&mutex);
+
+            return following;
+        }
+
+    private:
+
+        double distance(const TripletFP& p) const {
+            return sqrt((p.x - position.x) * (p.x - position.x) + (p.y - position.y) * (p.y - position.y));
+        }
+
+        /**
+         * Point of the path TRACKER_LOOKAHEAD from the bot, past the point
+         * closest to it; the end of the path once that is nearer. False when
+         * the bot has reached the end.
+         */
+        bool lookahead(TripletFP *goal) {
+            int last = points.size() - 1;
+            while (progress < last && distance(points[progress + 1]) <= distance(points[progress])) {
+                progress++;
+            }
+
+            if (distance(points[last]) < TRACKER_GOAL_RADIUS) {
+                return false;
+            }
+
+            for (int i = progress; i < last; i++) {
+                const TripletFP& a = points[i];
+                const TripletFP& b = points[i + 1];
+                if (distance(b) < TRACKER_LOOKAHEAD) {
+                    continue;
+                }
+
+                // Where the segment leaves the lookahead circle: |a + t (b - a) - position| = L
+                double dx = b.x - a.x, dy = b.y - a.y;
+                double fx = a.x - position.x, fy = a.y - position.y;
+                double qa = dx * dx + dy * dy;
+                double qb = 2 * (fx * dx + fy * dy);
+                double qc = fx * fx + fy * fy - TRACKER_LOOKAHEAD * TRACKER_LOOKAHEAD;
+                double t = qa > 0 ? (-qb + sqrt(max(0.0, qb * qb - 4 * qa * qc))) / (2 * qa) : 1;
+                t = min(1.0, max(0.0, t));
+
+                goal->x = a.x + t * dx;
+                goal->y = a.y + t * dy;
+                return true;
+            }
+
+            *goal = points[last];
+            return true;
+        }
+
+        /// Wheel velocities for the arc from the bot through goal
+        void steer(const TripletFP& goal, int *left_vel, int *right_vel) const {
+            double a = position.z * CV_PI / 180;
+            double dx = goal.x - position.x, dy = goal.y - position.y;
+            double ahead = dx * cos(a) + dy * sin(a);
+            double lateral = -dx * sin(a) + dy * cos(a); // to the left
+
+            double d2 = max(1.0, dx * dx + dy * dy);
+            double curvature = 2 * lateral / d2;
+            // A goal behind the bot turns it as hard as the lookahead allows
+            double max_curvature = 2.0 / TRACKER_LOOKAHEAD;
+            if (ahead < 0) {
+                curvature = lateral < 0 ? -max_curvature : max_curvature;
+            }
+            curvature = min(max_curvature, max(-max_curvature, curvature));
+
+            *left_vel = (int) (TRACKER_SPEED * (1 - curvature * TRACKER_WHEEL_BASE / 2));
+            *right_vel = (int) (TRACKER_SPEED * (1 + curvature * TRACKER_WHEEL_BASE / 2));
+        }
+
+        pthread_mutex_t mutex;
+        int mode; // TrackerModes
+        vector<TripletFP> points; // the bot's pose at publication, then the path
+        TripletFP position; // of the bot in the frame of the path, z the heading in degrees
+        int progress; // point of points closest to the bot so far
+        ros::WallTime published;
+        int left, right; // held command
+    };
+}
+
+#endif
@@ -0,0 +1,202 @@
+#ifndef _PLANNER_WORKSPACE_H_
+#define _PLANNER_WORKSPACE_H_
+
+#include <stdint.h>
+#include "planner.h"
+#include "plannerLattice.h"
+#include "plannerSeedTable.h"
+#include "plannerHeap.h"
+#include "plannerHeuristic.h"
+#include "plannerGoal.h"
+#include "plannerOccupancy.h"
+
+#define OPEN 1
+#define CLOSED 2
+#define UNASSIGNED 3
+#define INCONS 4
+
+namespace planner_space {
+
+    typedef struct lattice_node { // search node addressed through the lattice index
+        state s;
+        int parent; // -1 for the start node
+        char membership;
+        uint64_t edge_checked, edge_free; // bit i: seed i from this node, lazy collision checks
+    } lattice_node;
+
+    /**
+     * Everything a lattice search writes, and the seed set it searches with.
+     * The map state (occupancy, cost field, goal region) is shared and only
+     * read while searching, so searches on different workspaces may run at
+     * the same time. The planner's own searches use main_workspace, each
+     * portfolio worker has its own.
+     *
+     * allocate() reserves the nodes of max_iter expansions; the lattice
+     * index starts at 1.5 MB and grows with the nodes actually generated.
+     */
+    class SearchWorkspace {
+    public:
+
+        SearchWorkspace() : seeds(NULL), seed_table(NULL), heuristic_table(NULL), occupancy(NULL), cancelled(0) {
+        }
+
+        void bind(const vector<seed>& seed_set, const SeedTable& table, const HeuristicTable& h, const OccupancyGrid& grid) {
+            seeds = &seed_set;
+            seed_table = &table;
+            heuristic_table = &h;
+            occupancy = &grid;
+        }
+
+        void allocate(int max_iter) {
+            lattice.allocate();
+            nodes.reserve((max_iter + 1) * seeds->size() + 1);
+            successors.reserve(seeds->size());
+        }
+
+        /// Starts a new search, invalidating every node of the previous one
+        void reset() {
+            lattice.nextGeneration();
+            nodes.clear();
+            open_list.clear();
+
+            stats.expansions = 0;
+            stats.peak_open = 0;
+            stats.path_cost = -1;
+            stats.collision_checks = 0;
+        }
+
+        /// Returns the node for pose, -1 if it has not been generated in this search
+        int findNode(Triplet pose) const {
+            return lattice.find(LatticeIndex::key(pose));
+        }
+
+        int addNode(const state& s, int parent) {
+            lattice_node node;
+            node.s = s;
+            node.parent = parent;
+            node.membership = OPEN;
+            node.edge_checked = 0;
+            node.edge_free = 0;
+
+            nodes.push_back(node);
+            lattice.insert(LatticeIndex::key(s.pose), nodes.size() - 1);
+
+            return nodes.size() - 1;
+        }
+
+        /**
+         * Queues s, or moves its open lattice node onto the cheaper way in through
+         * parent (decrease-key). Closed nodes are final.
+         */
+        void relaxNode(const state& s, int parent, double f) {
+            int n = findNode(s.pose);
+
+            if (n == -1) {
+                open_list.push(addNode(s, parent), f);
+            } else if ((nodes[n].membership == OPEN) && (s.g_dist < nodes[n].s.g_dist)) {
+                nodes[n].s = s;
+                nodes[n].parent = parent;
+                open_list.update(n, f);
+            }
+        }
+
+        void countExpansion() {
+            stats.expansions++;
+            if (open_list.size() > stats.peak_open) {
+                stats.peak_open = open_list.size();
+            }
+        }
+
+        /// Euclidean distance, raised to the seed lattice's cost-to-go where the heuristic table knows it
+        double heuristic(Triplet a, Triplet b) const {
+            double d = sqrt((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y));
+            return max(d, heuristic_table->cost(a, b));
+        }
+
+        /// Fills neighbours with the successors of current, reusing its storage
+        void neighborNodes(const state& current, vector<state>& neighbours) const {
+            neighbours.clear();
+            for (unsigned int i = 0; i < seeds->size(); i++) {
+                const seed& sd = (*seeds)[i];
+                const seed_entry& e = seed_table->entry(current.pose.z, i);
+
+                state neighbour;
+                neighbour.pose.x = current.pose.x + e.dest.x;
+                neighbour.pose.y = current.pose.y + e.dest.y;
+
+                neighbour.pose.z = sd.dest.z - (90 - current.pose.z);
+                neighbour.h_dist = 0;
+                neighbour.seed_id = i;
+                neighbour.g_dist = sd.cost;
+                neighbour.h_obs = 0;
+                neighbour.g_obs = 0;
+
+                neighbours.push_back(neighbour);
+            }
+        }
+
+        /// Does some seed from current sweep a cell of the goal region
+        bool onTarget(const state& current, const GoalRegion& goal) const {
+            int x = current.pose.x;
+            int y = current.pose.y;
+
+            for (unsigned int i = 0; i < seeds->size(); i++) {
+                const seed_entry& e = seed_table->entry(current.pose.z, i);
+                if (!goal.overlaps(x + e.lo.x, y + e.lo.y, x + e.hi.x, y + e.hi.y)) {
+                    continue;
+                }
+
+                for (int k = e.span_begin; k < e.span_end; k++) {
+                    const swept_span& sp = seed_table->span(k);
+                    if (goal.window(x + sp.dx, y + sp.dy) & sp.mask) {
+                        return true;
+                    }
+                }
+            }
+
+            return false;
+        }
+
+        /// Is the seed s.seed_id from parent free of obstacles and inside the map
+        bool isWalkable(const state& parent, const state& s) {
+            return isWalkable(parent, s, *occupancy);
+        }
+
+        /// Same, on grid instead of the bound occupancy
+        bool isWalkable(const state& parent, const state& s, const OccupancyGrid& grid) {
+            stats.collision_checks++;
+            const seed_entry& e = seed_table->entry(parent.pose.z, s.seed_id);
+            int x = parent.pose.x;
+            int y = parent.pose.y;
+
+            // The box is tight, so it leaves the map iff some swept cell does
+            if (!(((0 <= x + e.lo.x) && (x + e.hi.x < MAP_MAX)) && ((0 <= y + e.lo.y) && (y + e.hi.y < MAP_MAX)))) {
+                return false;
+            }
+
+            for (int k = e.span_begin; k < e.span_end; k++) {
+                const swept_span& sp = seed_table->span(k);
+                if (grid.window(x + sp.dx, y + sp.dy) & sp.mask) {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        LatticeIndex lattice;
+        vector<lattice_node> nodes;
+        IndexedHeap<double> open_list; // node ids keyed on f
+        vector<state> successors; // scratch, cleared per expansion
+        planner_stats stats; // of the last search
+
+        const vector<seed> *seeds;
+        const SeedTable *seed_table;
+        const HeuristicTable *heuristic_table;
+        const OccupancyGrid *occupancy;
+
+        volatile int cancelled; // set from another thread, the search stops at its next check
+    };
+}
+
+#endif
@@ -0,0 +1,295 @@
+/**
+ * Offline planner benchmark. Needs no ROS master and opens no windows.
+ *
+ * Usage (from bin/, like the node, so that the seed files resolve):
+ *   planner_benchmark <corpus index> [--repeat N] [--modes 0,1,2,3,4,5,6]
+ *   planner_benchmark --synthetic N [--seed S] [--repeat N] [--modes 0,1,2,3,4,5,6]
+ *
+ * A corpus index has one case per line, '#' starts a comment:
+ *   <map image> <bot x y z> <target x y z>
+ * Map images are 1000x1000 grayscale in the planner's image frame (as written
+ * by planner_thread with RECORD_CORPUS), any non zero pixel is an obstacle.
+ * Paths are relative to the index file.
+ *
+ * For every planner mode the report gives expansions per second, p50/p99
+ * latency of one planner call, collision checks per call, the largest open
+ * list and the mean path cost of the solved runs.
+ */
+
+#include "planner.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <string.h>
+#include <math.h>
+
+#define BENCHMARK_REPEAT 5
+
+/* Globals the planner expects from the node */
+Pose pose;
+vector<Triplet> path;
+pthread_mutex_t pose_mutex;
+pthread_mutex_t path_mutex;
+
+char **local_map;
+int ol_overflow;
+int last_cmd;
+
+typedef struct benchmark_case {
+    cv::Mat image; // image frame
+    Triplet bot, target;
+    string name;
+} benchmark_case;
+
+typedef struct benchmark_result {
+    vector<double> latencies; // seconds
+    double total_time;
+    long expansions;
+    long collision_checks;
+    int peak_open;
+    int solved;
+    double cost_sum;
+} benchmark_result;
+
+static unsigned char cells[MAP_MAX][MAP_MAX];
+
+static const char *mode_names[] = {"PlainAStar", "DistTransformAStar", "IncrementalAStar", "AnytimeAStar", "HybridAStar", "PortfolioAStar", "DynamicAStar"};
+
+/// Makes local_map point at the case's cells, as planner_thread does with a map snapshot
+void loadCase(const benchmark_case& c) {
+    for (int i = 0; i < MAP_MAX; i++) {
+        for (int j = 0; j < MAP_MAX; j++) {
+            cells[i][j] = c.image.at<uchar > (MAP_MAX - 1 - j, i) ? 255 : 0;
+        }
+        local_map[i] = (char *) cells[i];
+    }
+    planner_space::Planner::updateOccupancy();
+    // Recorded maps carry no obstacle tracks, findPathDynamic sees every obstacle as static
+    planner_space::Planner::updateObstacles(vector<Obstacle>(), ros::WallTime::now().toSec());
+}
+
+bool readCorpus(const string& index_file, vector<benchmark_case>& cases) {
+    ifstream index(index_file.c_str());
+    if (!index.is_open()) {
+        ROS_ERROR("[BENCHMARK] Unable to open %s", index_file.c_str());
+        return false;
+    }
+
+    string dir = "";
+    size_t slash = index_file.rfind('/');
+    if (slash != string::npos) {
+        dir = index_file.substr(0, slash + 1);
+    }
+
+    string line;
+    while (getline(index, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        benchmark_case c;
+        istringstream fields(line);
+        if (!(fields >> c.name >> c.bot.x >> c.bot.y >> c.bot.z >> c.target.x >> c.target.y >> c.target.z)) {
+            ROS_ERROR("[BENCHMARK] Bad corpus line: %s", line.c_str());
+            return false;
+        }
+
+        string file = c.name[0] == '/' ? c.name : dir + c.name;
+        c.image = cv::imread(file, 0);
+        if (c.image.empty() || c.image.rows != MAP_MAX || c.image.cols != MAP_MAX) {
+            ROS_ERROR("[BENCHMARK] %s is not a %dx%d map", file.c_str(), MAP_MAX, MAP_MAX);
+            return false;
+        }
+        cases.push_back(c);
+    }
+
+    return true;
+}
+
+/// Random boxes and discs in front of the bot, bot at (500, 100, 90) like on the vehicle
+void makeSynthetic(int n_cases, unsigned int seed, vector<benchmark_case>& cases) {
+    srand(seed);
+
+    for (int k = 0; k < n_cases; k++) {
+        benchmark_case c;
+        c.image = cv::Mat(MAP_MAX, MAP_MAX, CV_8UC1, cv::Scalar(0));
+        c.bot.x = 500;
+        c.bot.y = 100;
+        c.bot.z = 90;
+        c.target.x = 100 + rand() % 800;
+        c.target.y = 700 + rand() % 250;
+        c.target.z = 90;
+
+        int n_obstacles = 5 + rand() % 20;
+        for (int o = 0; o < n_obstacles; o++) {
+            int x = rand() % MAP_MAX;
+            int y = 250 + rand() % 450;
+            int r = 10 + rand() % 50;
+            if (rand() % 2) {
+                cv::circle(c.image, cvPoint(x, MAP_MAX - 1 - y), r, cv::Scalar(255), -1);
+            } else {
+                cv::rectangle(c.image, cvPoint(x - r, MAP_MAX - 1 - y - r / 3), cvPoint(x + r, MAP_MAX - 1 - y + r / 3), cv::Scalar(255), -1);
+            }
+        }
+
+        ostringstream name;
+        name << "synthetic_" << k;
+        c.name = name.str();
+        cases.push_back(c);
+    }
+}
+
+geometry_msgs::Twist runMode(int mode, Triplet bot, Triplet target, cv::Mat image) {
+    switch (mode) {
+        case PlainAStar:
+            return planner_space::Planner::findPath(bot, target, image);
+        case DistTransformAStar:
+            return planner_space::Planner::findPathDT(bot, target, image);
+        case IncrementalAStar:
+            return planner_space::Planner::findPathIncremental(bot, target, image);
+        case AnytimeAStar:
+            return planner_space::Planner::findPathAnytime(bot, target, image);
+        case HybridAStar:
+            return planner_space::Planner::findPathHybrid(bot, target, image);
+        case PortfolioAStar:
+            return planner_space::Planner::findPathPortfolio(bot, target, image);
+        default:
+            return planner_space::Planner::findPathDynamic(bot, target, image);
+    }
+}
+
+double percentile(vector<double> values, double q) {
+    if (values.empty()) {
+        return 0;
+    }
+
+    sort(values.begin(), values.end());
+    int k = (int) ceil(q * values.size()) - 1;
+    return values[max(0, min(k, (int) values.size() - 1))];
+}
+
+int main(int argc, char **argv) {
+    string index_file = "";
+    int n_synthetic = 0;
+    unsigned int seed = 1;
+    int repeat = BENCHMARK_REPEAT;
+    vector<int> modes;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--synthetic" && i + 1 < argc) {
+            n_synthetic = atoi(argv[++i]);
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seed = atoi(argv[++i]);
+        } else if (arg == "--repeat" && i + 1 < argc) {
+            repeat = atoi(argv[++i]);
+        } else if (arg == "--modes" && i + 1 < argc) {
+            istringstream list(argv[++i]);
+            string m;
+            while (getline(list, m, ',')) {
+                modes.push_back(atoi(m.c_str()));
+            }
+        } else {
+            index_file = arg;
+        }
+    }
+
+    if ((index_file == "" && n_synthetic <= 0) || repeat <= 0) {
+        printf("Usage: %s <corpus index> | --synthetic N [--seed S] [--repeat N] [--modes 0,1,2,3,4,5,6]\n", argv[0]);
+        return 1;
+    }
+    if (modes.empty()) {
+        for (int m = PlainAStar; m <= DynamicAStar; m++) {
+            modes.push_back(m);
+        }
+    }
+
+    // Planner commands are logged at INFO on every call
+    if (ros::console::set_logger_level(ROSCONSOLE_DEFAULT_NAME, ros::console::levels::Warn)) {
+        ros::console::notifyLoggerLevelsChanged();
+    }
+
+    pthread_mutex_init(&pose_mutex, NULL);
+    pthread_mutex_init(&path_mutex, NULL);
+    local_map = new char*[MAP_MAX];
+
+    vector<benchmark_case> cases;
+    if (n_synthetic > 0) {
+        makeSynthetic(n_synthetic, seed, cases);
+    } else if (!readCorpus(index_file, cases)) {
+        return 1;
+    }
+    if (cases.empty()) {
+        ROS_ERROR("[BENCHMARK] Empty corpus");
+        return 1;
+    }
+
+    planner_space::Planner::loadPlanner();
+
+    printf("%d cases x %d runs\n", (int) cases.size(), repeat);
+    printf("%-20s %8s %8s %12s %10s %10s %10s %10s %10s\n",
+            "mode", "runs", "solved", "exp/s", "p50 ms", "p99 ms", "checks", "peak open", "mean cost");
+
+    for (unsigned int m = 0; m < modes.size(); m++) {
+        int mode = modes[m];
+        if (mode < PlainAStar || mode > DynamicAStar) {
+            ROS_WARN("[BENCHMARK] Unknown planner mode %d", mode);
+            continue;
+        }
+
+        benchmark_result result;
+        result.total_time = 0;
+        result.expansions = 0;
+        result.collision_checks = 0;
+        result.peak_open = 0;
+        result.solved = 0;
+        result.cost_sum = 0;
+        vector<double> field_times;
+
+        for (unsigned int c = 0; c < cases.size(); c++) {
+            loadCase(cases[c]);
+
+            if (mode == DistTransformAStar || mode == PortfolioAStar) {
+                // Runs once per map update in planner_thread, reported on its own
+                ros::WallTime field_start = ros::WallTime::now();
+                planner_space::Planner::updateCostField(cases[c].image);
+                field_times.push_back((ros::WallTime::now() - field_start).toSec());
+            }
+
+            for (int r = 0; r < repeat; r++) {
+                ol_overflow = 0;
+
+                ros::WallTime start = ros::WallTime::now();
+                runMode(mode, cases[c].bot, cases[c].target, cases[c].image);
+                double elapsed = (ros::WallTime::now() - start).toSec();
+
+                planner_space::planner_stats stats = planner_space::Planner::lastStats();
+                result.latencies.push_back(elapsed);
+                result.total_time += elapsed;
+                result.expansions += stats.expansions;
+                result.collision_checks += stats.collision_checks;
+                result.peak_open = max(result.peak_open, stats.peak_open);
+                if (stats.path_cost >= 0) {
+                    result.solved++;
+                    result.cost_sum += stats.path_cost;
+                }
+            }
+        }
+
+        printf("%-20s %8d %8d %12.0f %10.3f %10.3f %10.0f %10d %10.1f\n",
+                mode_names[mode], (int) result.latencies.size(), result.solved,
+                result.total_time > 0 ? result.expansions / result.total_time : 0,
+                percentile(result.latencies, 0.5) * 1000, percentile(result.latencies, 0.99) * 1000,
+                result.latencies.empty() ? 0 : (double) result.collision_checks / result.latencies.size(),
+                result.peak_open, result.solved ? result.cost_sum / result.solved : 0);
+
+        if (!field_times.empty()) {
+            printf("%-20s %8d %8s %12s %10.3f %10.3f\n",
+                    "  cost field update", (int) field_times.size(), "", "",
+                    percentile(field_times, 0.5) * 1000, percentile(field_times, 0.99) * 1000);
+        }
+    }
+
+    return 0;
+}
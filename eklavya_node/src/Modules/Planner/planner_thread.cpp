@@ -1,15 +1,64 @@
 #include "planner.h"
+#include "../../Utils/MapBuffer/map_buffer.h"
+#include "../../Utils/EgoMotion/ego_motion.h"
 
 #include <sstream>
+#include <fstream>
 //#define FPS_TEST
 
+/**
+ * Saves every RECORD_EVERY-th map with its bot and target to CORPUS_DIR,
+ * as input for planner_benchmark. The directory must exist.
+ */
+//#define RECORD_CORPUS
+#define RECORD_EVERY 20
+#define CORPUS_DIR "../corpus/"
+
+/**
+ * Planner Modes:
+ * 0: A* on the seed lattice (findPath)
+ * 1: A* with the Voronoi/DT cost field, retried w/o DT on overflow (findPathDT)
+ * 2: D* Lite, keeps its search tree in a world frame across cycles and repairs
+ *    it where the map changed, see plannerIncremental.h (findPathIncremental)
+ * 3: Anytime A*, best path found within ANYTIME_BUDGET (findPathAnytime)
+ * 4: Hybrid A*, continuous poses with analytic shots to the target (findPathHybrid)
+ * 5: Portfolio of lattice searches on all cores, see plannerPortfolio.h (findPathPortfolio)
+ * 6: A* checking seeds against where tracked obstacles will be, see plannerDynamic.h (findPathDynamic)
+ */
+#define PLANNER_MODE PlainAStar
+
 char **local_map;
 //IplImage *map_img;
 
+/// Cycles per second of tracker_thread, see plannerTracker.h
+#define TRACKER_LOOP_RATE 50
+
 int ol_overflow;
 //geometry_msgs::Twist precmdvel;
 int last_cmd;
 
+/**
+ * Steers along the last published path between planner cycles (PID_MODE 3),
+ * with its own motion estimate of the bot.
+ */
+void *tracker_thread(void *arg) {
+    ros::NodeHandle nh;
+    ros::Publisher vel_pub = nh.advertise<geometry_msgs::Twist > ("cmd_vel", 1);
+
+    EgoMotion ego_motion;
+    ros::Rate loop_rate(TRACKER_LOOP_RATE);
+    geometry_msgs::Twist cmdvel;
+
+    while (ros::ok()) {
+        planner_space::Planner::trackPath(ego_motion.update(), &cmdvel);
+        vel_pub.publish(cmdvel);
+
+        loop_rate.sleep();
+    }
+
+    return NULL;
+}
+
 void *planner_thread(void *arg) {
     Triplet my_bot_location;
     Triplet my_target_location;
@@ -26,16 +75,24 @@ void *planner_thread(void *arg) {
 
     cvNamedWindow("[PLANNER] Map", 0);
 
-    //initializing local map
+    //local map rows point into the borrowed map snapshot
     local_map = new char*[MAP_MAX];
-    for (int i = 0; i < MAP_MAX; i++) {
-        local_map[i] = new char[MAP_MAX];
-    }
+    int packed_version = -1;
 
     ROS_INFO("Initiating Planner");
     planner_space::Planner::loadPlanner();
     ROS_INFO("Planner Initiated");
 
+    // The planner then only publishes paths, the tracker publishes every command
+    bool tracking = planner_space::Planner::tracksPath();
+    if (tracking) {
+        pthread_t tracker_id;
+        if (pthread_create(&tracker_id, NULL, &tracker_thread, NULL)) {
+            ROS_ERROR("[PLANNER] Unable to create the tracker thread");
+            tracking = false;
+        }
+    }
+
     ROS_INFO("Waiting for Target");
     usleep(999999);
     usleep(999999);
@@ -45,13 +102,18 @@ void *planner_thread(void *arg) {
     time_t start = time(0);
 #endif
 
+#ifdef RECORD_CORPUS
+    int recorded = 0, cycles = 0;
+    ofstream corpus_index((string(CORPUS_DIR) + "index.txt").c_str(), ios::app);
+#endif
+
+    EgoMotion ego_motion;
+    vector<Obstacle> my_obstacles;
     ros::Rate loop_rate(LOOP_RATE);
     geometry_msgs::Twist cmdvel;
     last_cmd = LEFT_CMD;
 
     while (ros::ok()) {
-        cv::Mat map_img(MAP_MAX, MAP_MAX, CV_8UC1, cv::Scalar(0));
-
 #ifdef FPS_TEST
         if (iterations > 1000) {
             time_t finish = time(0);
@@ -89,14 +151,31 @@ void *planner_thread(void *arg) {
         pthread_mutex_unlock(&target_location_mutex);
 #endif
 
-        pthread_mutex_lock(&global_map_mutex);
+        // Borrowed read-only until the end of this cycle, nothing is copied
+        const map_snapshot *snapshot = global_map_buffer.acquire();
         for (int i = 0; i < MAP_MAX; i++) {
-            for (int j = 0; j < MAP_MAX; j++) {
-                map_img.at<uchar > (MAP_MAX - 1 - j, i) = global_map[i][j];
-                local_map[i][j] = global_map[i][j];
-            }
+            local_map[i] = (char *) snapshot->cells[i];
+        }
+        cv::Mat map_img = snapshot->image;
+
+        if ((int) snapshot->version != packed_version) {
+            planner_space::Planner::updateOccupancy();
+            packed_version = snapshot->version;
+        }
+
+        // The last path is reused from where the bot is now
+        planner_space::Planner::updateEgoMotion(ego_motion.update(), ros::WallTime::now().toSec());
+
+#ifdef RECORD_CORPUS
+        if (cycles++ % RECORD_EVERY == 0 && snapshot->version > 0) {
+            ostringstream name;
+            name << "map_" << time(0) << "_" << recorded++ << ".png";
+            cv::imwrite(CORPUS_DIR + name.str(), map_img);
+            corpus_index << name.str() << " "
+                    << my_bot_location.x << " " << my_bot_location.y << " " << my_bot_location.z << " "
+                    << my_target_location.x << " " << my_target_location.y << " " << my_target_location.z << endl;
         }
-        pthread_mutex_unlock(&global_map_mutex);
+#endif
        // my_target_location.x = 500;
        // my_target_location.y = 900;
        // my_target_location.z = 90; 
@@ -104,13 +183,65 @@ void *planner_thread(void *arg) {
        // my_bot_location.y = 100;
        // my_bot_location.z = 90;
         ol_overflow = 0;
-        cmdvel = planner_space::Planner::findPath(my_bot_location, my_target_location, map_img);
-        if (ol_overflow == 1) {
-            ol_overflow = 0;
-            cmdvel = planner_space::Planner::findPath(my_bot_location, my_target_location, map_img);
+        switch (PLANNER_MODE) {
+            case PlainAStar:
+            {
+                cmdvel = planner_space::Planner::findPath(my_bot_location, my_target_location, map_img);
+                if (ol_overflow == 1) {
+                    ol_overflow = 0;
+                    cmdvel = planner_space::Planner::findPath(my_bot_location, my_target_location, map_img);
+                }
+                break;
+            }
+            case DistTransformAStar:
+            {
+                // Only the tiles that changed since the last cycle are recomputed
+                planner_space::Planner::updateCostField(map_img);
+                cmdvel = planner_space::Planner::findPathDT(my_bot_location, my_target_location, map_img);
+                if (ol_overflow == 1) {
+                    ol_overflow = 0;
+                    cmdvel = planner_space::Planner::findPath(my_bot_location, my_target_location, map_img);
+                }
+                break;
+            }
+            case IncrementalAStar:
+            {
+                cmdvel = planner_space::Planner::findPathIncremental(my_bot_location, my_target_location, map_img);
+                break;
+            }
+            case AnytimeAStar:
+            {
+                cmdvel = planner_space::Planner::findPathAnytime(my_bot_location, my_target_location, map_img);
+                break;
+            }
+            case HybridAStar:
+            {
+                cmdvel = planner_space::Planner::findPathHybrid(my_bot_location, my_target_location, map_img);
+                break;
+            }
+            case PortfolioAStar:
+            {
+                planner_space::Planner::updateCostField(map_img);
+                cmdvel = planner_space::Planner::findPathPortfolio(my_bot_location, my_target_location, map_img);
+                break;
+            }
+            case DynamicAStar:
+            {
+                pthread_mutex_lock(&obstacles_mutex);
+                my_obstacles = obstacles;
+                pthread_mutex_unlock(&obstacles_mutex);
+
+                planner_space::Planner::updateObstacles(my_obstacles, ros::WallTime::now().toSec());
+                cmdvel = planner_space::Planner::findPathDynamic(my_bot_location, my_target_location, map_img);
+                break;
+            }
         }
         
-        vel_pub.publish(cmdvel);
+        global_map_buffer.release(snapshot);
+
+        if (!tracking) {
+            vel_pub.publish(cmdvel);
+        }
 
         loop_rate.sleep();
     }
@@ -0,0 +1,37 @@
+#include "ego_motion.h"
+#include <math.h>
+
+EgoMotion::EgoMotion() : started(false), last_yaw(0) {
+}
+
+TripletFP EgoMotion::update() {
+    TripletFP motion;
+    motion.x = motion.y = motion.z = 0;
+
+    pthread_mutex_lock(&odom_mutex);
+    double velocity = (odom.left_velocity + odom.right_velocity) / 2;
+    pthread_mutex_unlock(&odom_mutex);
+
+    pthread_mutex_lock(&pose_mutex);
+    double yaw = pose.orientation.z;
+    pthread_mutex_unlock(&pose_mutex);
+
+    ros::WallTime now = ros::WallTime::now();
+
+    if (started) {
+        double turn = fmod(yaw - last_yaw + 540, 360) - 180;
+        double distance = velocity * (now - last_time).toSec() * EGO_MAP_SCALE;
+
+        // Constant curvature over the interval: the bot moves along the chord, at half the turn
+        double half_turn = turn * CV_PI / 360;
+        motion.x = -distance * sin(half_turn);
+        motion.y = distance * cos(half_turn);
+        motion.z = turn;
+    }
+
+    started = true;
+    last_time = now;
+    last_yaw = yaw;
+
+    return motion;
+}
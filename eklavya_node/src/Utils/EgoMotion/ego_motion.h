@@ -0,0 +1,29 @@
+#ifndef _EGO_MOTION_H_
+#define _EGO_MOTION_H_
+
+#include "../../eklavya2.h"
+
+/// Map cells per meter, as in the navigation strategies
+#define EGO_MAP_SCALE 100
+
+/**
+ * Motion of the bot between two calls of update(), dead reckoned from the
+ * wheel velocities (odom, m/s) and the IMU yaw (pose.orientation.z, degrees,
+ * counter clockwise). The result is in the bot frame of the previous call,
+ * along the map's axes: x to the right, y ahead, z the heading change in
+ * degrees, positive to the left.
+ */
+class EgoMotion {
+public:
+    EgoMotion();
+
+    /// Motion since the previous call, zero on the first one
+    TripletFP update();
+
+private:
+    bool started;
+    ros::WallTime last_time;
+    double last_yaw;
+};
+
+#endif
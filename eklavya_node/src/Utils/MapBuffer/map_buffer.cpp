@@ -0,0 +1,114 @@
+#include "map_buffer.h"
+#include <errno.h>
+#include <string.h>
+#include <sys/time.h>
+
+MapSignal::MapSignal() : generation(0) {
+    pthread_mutex_init(&mutex, NULL);
+    pthread_cond_init(&raised, NULL);
+}
+
+MapSignal::~MapSignal() {
+    pthread_cond_destroy(&raised);
+    pthread_mutex_destroy(&mutex);
+}
+
+void MapSignal::raise() {
+    pthread_mutex_lock(&mutex);
+    generation++;
+    pthread_cond_broadcast(&raised);
+    pthread_mutex_unlock(&mutex);
+}
+
+bool MapSignal::wait(unsigned int *seen, double timeout) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    long nsec = now.tv_usec * 1000 + (long) (timeout * 1e9);
+    struct timespec deadline;
+    deadline.tv_sec = now.tv_sec + nsec / 1000000000;
+    deadline.tv_nsec = nsec % 1000000000;
+
+    pthread_mutex_lock(&mutex);
+    while (generation == *seen) {
+        if (pthread_cond_timedwait(&raised, &mutex, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    bool woken = generation != *seen;
+    *seen = generation;
+    pthread_mutex_unlock(&mutex);
+
+    return woken;
+}
+
+MapBuffer::MapBuffer() {
+    slots = new map_snapshot[MAP_BUFFER_SLOTS];
+    for (int i = 0; i < MAP_BUFFER_SLOTS; i++) {
+        memset(slots[i].cells, 0, sizeof (slots[i].cells));
+        slots[i].image = cv::Mat(MAP_MAX, MAP_MAX, CV_8UC1, cv::Scalar(0));
+        slots[i].version = 0;
+        slots[i].readers = 0;
+    }
+
+    // Readers started before the first publish see an empty map
+    latest = &slots[0];
+    last_version = 0;
+    signal = NULL;
+}
+
+MapBuffer::~MapBuffer() {
+    delete [] slots;
+}
+
+map_snapshot *MapBuffer::beginWrite() {
+    for (int i = 0; i < MAP_BUFFER_SLOTS; i++) {
+        // A reader that has just counted itself in will see it is not the latest buffer and leave
+        if (&slots[i] != latest && __sync_bool_compare_and_swap(&slots[i].readers, 0, MAP_BUFFER_WRITING)) {
+            return &slots[i];
+        }
+    }
+
+    return NULL;
+}
+
+void MapBuffer::publish(map_snapshot *snapshot) {
+    snapshot->version = last_version + 1;
+    // A full barrier, so the cells and version are complete before readers can count themselves in.
+    // Readers that tried while it was claimed are backing off, their decrements must still land.
+    __sync_fetch_and_sub(&snapshot->readers, MAP_BUFFER_WRITING);
+    latest = snapshot;
+    __sync_synchronize();
+    last_version = snapshot->version;
+
+    MapSignal *s = signal;
+    if (s != NULL) {
+        s->raise();
+    }
+}
+
+const map_snapshot *MapBuffer::acquire() {
+    while (true) {
+        map_snapshot *snapshot = latest;
+        int before = __sync_fetch_and_add(&snapshot->readers, 1);
+
+        // Claimed by the writer after we read latest, or already replaced by a newer map
+        if (before < 0 || snapshot != latest) {
+            __sync_fetch_and_sub(&snapshot->readers, 1);
+            continue;
+        }
+
+        return snapshot;
+    }
+}
+
+void MapBuffer::release(const map_snapshot *snapshot) {
+    __sync_fetch_and_sub(&const_cast<map_snapshot *> (snapshot)->readers, 1);
+}
+
+unsigned int MapBuffer::version() {
+    return last_version;
+}
+
+void MapBuffer::attach(MapSignal *s) {
+    signal = s;
+}
@@ -0,0 +1,83 @@
+#ifndef _MAP_BUFFER_H_
+#define _MAP_BUFFER_H_
+
+#include "../../eklavya2.h"
+
+/**
+ * Buffers in the pool: the one being written, the latest one, and one per
+ * reader thread that may hold a snapshot across a cycle (planner, diagnostics
+ * on the global map; fusion on the lidar and camera maps).
+ */
+#define MAP_BUFFER_SLOTS 4
+
+/// readers of a buffer the writer has claimed, readers back off from it
+#define MAP_BUFFER_WRITING (-(1 << 20))
+
+typedef struct map_snapshot {
+    unsigned char cells[MAP_MAX][MAP_MAX]; // [x][y], as the old global_map
+    cv::Mat image; // same cells in image frame: row MAP_MAX - 1 - y, column x
+    unsigned int version; // 0 for the initial empty map
+    volatile int readers; // MAP_BUFFER_WRITING while the writer fills it
+} map_snapshot;
+
+/**
+ * Wakes a thread when any of the buffers attached to it publishes (see
+ * MapBuffer::attach), so it can work on new maps instead of polling them.
+ * Only publishing and waiting lock, never the readers of the maps.
+ */
+class MapSignal {
+public:
+    MapSignal();
+    virtual ~MapSignal();
+
+    void raise();
+    /// Waits up to timeout seconds for a raise() after the one seen last, false on timeout
+    bool wait(unsigned int *seen, double timeout);
+
+private:
+    pthread_mutex_t mutex;
+    pthread_cond_t raised;
+    unsigned int generation;
+};
+
+/**
+ * Versioned map handoff between one writer and several readers, used for
+ * every map passed between threads (lidar_map_buffer, camera_map_buffer,
+ * global_map_buffer).
+ *
+ * The writer fills a free buffer and publishes it by pointer swap. Readers
+ * borrow the latest buffer read-only and give it back when done, so no map
+ * is ever copied. A buffer is not rewritten while any reader still holds it.
+ *
+ * Nothing locks: readers count themselves in with an atomic increment and
+ * check that the buffer is still the latest one, the writer claims a buffer
+ * by swapping its reader count from 0 to MAP_BUFFER_WRITING. Each buffer has
+ * a single writer thread.
+ */
+class MapBuffer {
+public:
+    MapBuffer();
+    virtual ~MapBuffer();
+
+    /// Writer: a buffer nobody reads, NULL if all are busy
+    map_snapshot *beginWrite();
+    /// Writer: makes the buffer from beginWrite() the latest one
+    void publish(map_snapshot *snapshot);
+
+    /// Reader: borrows the latest buffer, never NULL
+    const map_snapshot *acquire();
+    void release(const map_snapshot *snapshot);
+
+    unsigned int version();
+
+    /// Raises signal after every publish, NULL to stop
+    void attach(MapSignal *signal);
+
+private:
+    map_snapshot *slots;
+    map_snapshot * volatile latest;
+    volatile unsigned int last_version;
+    MapSignal * volatile signal;
+};
+
+#endif
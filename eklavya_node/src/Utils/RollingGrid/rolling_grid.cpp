@@ -0,0 +1,138 @@
+#include "rolling_grid.h"
+#include <math.h>
+#include <string.h>
+
+RollingGrid::RollingGrid() {
+    cells = new signed char[ROLLING_GRID_SIZE * ROLLING_GRID_SIZE];
+    clear();
+}
+
+RollingGrid::~RollingGrid() {
+    delete [] cells;
+}
+
+void RollingGrid::clear() {
+    memset(cells, 0, ROLLING_GRID_SIZE * ROLLING_GRID_SIZE);
+    bot_x = bot_y = 0;
+    heading = 90; // the grid starts out aligned with the map
+    sin_heading = 1;
+    cos_heading = 0;
+    center_x = center_y = 0;
+}
+
+void RollingGrid::move(TripletFP motion) {
+    bot_x += motion.y * cos_heading + motion.x * sin_heading;
+    bot_y += motion.y * sin_heading - motion.x * cos_heading;
+    heading = fmod(heading + motion.z, 360);
+    sin_heading = sin(heading * CV_PI / 180);
+    cos_heading = cos(heading * CV_PI / 180);
+
+    scroll((int) floor(bot_x + 0.5), (int) floor(bot_y + 0.5));
+}
+
+void RollingGrid::scroll(int new_x, int new_y) {
+    const int half = ROLLING_GRID_SIZE / 2;
+
+    if (abs(new_x - center_x) >= ROLLING_GRID_SIZE || abs(new_y - center_y) >= ROLLING_GRID_SIZE) {
+        memset(cells, 0, ROLLING_GRID_SIZE * ROLLING_GRID_SIZE);
+        center_x = new_x;
+        center_y = new_y;
+        return;
+    }
+
+    // The columns and rows that enter the window reuse the storage of those that left it
+    int from = new_x > center_x ? center_x + half : new_x - half;
+    int to = new_x > center_x ? new_x + half : center_x - half;
+    for (int gx = from; gx < to; gx++) {
+        for (int gy = 0; gy < ROLLING_GRID_SIZE; gy++) {
+            cells[(gy << ROLLING_GRID_BITS) + (gx & ROLLING_GRID_MASK)] = 0;
+        }
+    }
+
+    from = new_y > center_y ? center_y + half : new_y - half;
+    to = new_y > center_y ? new_y + half : center_y - half;
+    for (int gy = from; gy < to; gy++) {
+        memset(cells + ((gy & ROLLING_GRID_MASK) << ROLLING_GRID_BITS), 0, ROLLING_GRID_SIZE);
+    }
+
+    center_x = new_x;
+    center_y = new_y;
+}
+
+void RollingGrid::toGrid(int x, int y, int *gx, int *gy) const {
+    double dx = x - ROLLING_BOT_X, dy = y - ROLLING_BOT_Y; // right, ahead
+    *gx = (int) floor(bot_x + dx * sin_heading + dy * cos_heading + 0.5);
+    *gy = (int) floor(bot_y - dx * cos_heading + dy * sin_heading + 0.5);
+}
+
+bool RollingGrid::inside(int gx, int gy) const {
+    const int half = ROLLING_GRID_SIZE / 2;
+    return gx - center_x >= -half && gx - center_x < half && gy - center_y >= -half && gy - center_y < half;
+}
+
+void RollingGrid::update(int gx, int gy, int delta) {
+    if (!inside(gx, gy)) {
+        return;
+    }
+
+    signed char& c = cells[((gy & ROLLING_GRID_MASK) << ROLLING_GRID_BITS) + (gx & ROLLING_GRID_MASK)];
+    c = (signed char) max(-ROLLING_CLAMP, min(ROLLING_CLAMP, c + delta));
+}
+
+void RollingGrid::ray(int x0, int y0, int x1, int y1, bool hit) {
+    int gx, gy, ex, ey;
+    toGrid(x0, y0, &gx, &gy);
+    toGrid(x1, y1, &ex, &ey);
+
+    // Bresenham, every cell before the end is free
+    int dx = abs(ex - gx), dy = -abs(ey - gy);
+    int sx = gx < ex ? 1 : -1, sy = gy < ey ? 1 : -1;
+    int err = dx + dy;
+    while (gx != ex || gy != ey) {
+        update(gx, gy, -ROLLING_MISS);
+        int e2 = 2 * err;
+        if (e2 >= dy) {
+            err += dy;
+            gx += sx;
+        }
+        if (e2 <= dx) {
+            err += dx;
+            gy += sy;
+        }
+    }
+
+    if (hit) {
+        update(ex, ey, ROLLING_HIT);
+    }
+}
+
+void RollingGrid::observe(int x, int y, bool occupied) {
+    int gx, gy;
+    toGrid(x, y, &gx, &gy);
+    update(gx, gy, occupied ? ROLLING_HIT : -ROLLING_MISS);
+}
+
+void RollingGrid::render(unsigned char *image, int step) const {
+    double right_x = sin_heading, right_y = -cos_heading;
+    double ahead_x = cos_heading, ahead_y = sin_heading;
+
+    for (int y = 0; y < MAP_MAX; y++) {
+        unsigned char *row = image + (MAP_MAX - 1 - y) * step;
+        double wx = bot_x - ROLLING_BOT_X * right_x + (y - ROLLING_BOT_Y) * ahead_x + 0.5;
+        double wy = bot_y - ROLLING_BOT_X * right_y + (y - ROLLING_BOT_Y) * ahead_y + 0.5;
+
+        for (int x = 0; x < MAP_MAX; x++, wx += right_x, wy += right_y) {
+            int gx = (int) floor(wx), gy = (int) floor(wy);
+            bool occupied = inside(gx, gy) &&
+                    cells[((gy & ROLLING_GRID_MASK) << ROLLING_GRID_BITS) + (gx & ROLLING_GRID_MASK)] >= ROLLING_OCCUPIED;
+            row[x] = occupied ? 255 : 0;
+        }
+    }
+}
+
+void inflateMap(IplImage *img, int radius, IplImage *dist) {
+    // Distance to the nearest occupied cell: occupied cells must be the zeros
+    cvThreshold(img, img, 0, 255, CV_THRESH_BINARY_INV);
+    cvDistTransform(img, dist, CV_DIST_L2, 3);
+    cvCmpS(dist, radius, img, CV_CMP_LE);
+}
@@ -0,0 +1,77 @@
+#ifndef _ROLLING_GRID_H_
+#define _ROLLING_GRID_H_
+
+#include "../../eklavya2.h"
+
+/**
+ * Side of the grid in cells, a power of two so that cells are found by
+ * masking. It must hold the whole robot-centric map at any heading: the map
+ * corner furthest from the bot is about 1030 cells away, so only the very
+ * corners of a turned map fall outside a 2048 cell grid and read as free.
+ */
+#define ROLLING_GRID_BITS 11
+#define ROLLING_GRID_SIZE (1 << ROLLING_GRID_BITS)
+#define ROLLING_GRID_MASK (ROLLING_GRID_SIZE - 1)
+
+/// The bot's cell in the robot-centric maps, as the planner's start
+#define ROLLING_BOT_X 500
+#define ROLLING_BOT_Y 100
+
+/* Log-odds, in steps of a signed char */
+#define ROLLING_HIT 30
+#define ROLLING_MISS 10
+#define ROLLING_CLAMP 100 // evidence is capped so that a cell can still be freed within a few scans
+#define ROLLING_OCCUPIED 25 // a single hit marks a cell, as the per-scan maps did
+
+/**
+ * Occupancy evidence accumulated across frames around the bot.
+ *
+ * The grid is fixed to the ground and keeps its own north; the bot moves
+ * and turns in it by move() (motion from EgoMotion). Observations and
+ * render() go through the bot's pose, so callers work in the robot-centric
+ * map frame as everywhere else: x right, y ahead, the bot at ROLLING_BOT_X,
+ * ROLLING_BOT_Y.
+ *
+ * The grid stays centred on the bot by circular indexing: moving shifts its
+ * origin, and only the rows and columns that scroll in are cleared.
+ */
+class RollingGrid {
+public:
+    RollingGrid();
+    virtual ~RollingGrid();
+
+    /// The bot moved by motion since the last call (see EgoMotion)
+    void move(TripletFP motion);
+
+    /// A beam from (x0, y0) found an obstacle at (x1, y1) if hit, the cells on its way are free
+    void ray(int x0, int y0, int x1, int y1, bool hit);
+    /// Cell (x, y) seen occupied or free
+    void observe(int x, int y, bool occupied);
+
+    /// Writes the occupied cells as 255, the rest 0, into a MAP_MAX square single channel image
+    void render(unsigned char *image, int step) const;
+
+    void clear();
+
+private:
+    void toGrid(int x, int y, int *gx, int *gy) const;
+    bool inside(int gx, int gy) const;
+    void update(int gx, int gy, int delta);
+    void scroll(int new_x, int new_y);
+
+    signed char *cells; // [gy & MASK][gx & MASK]
+    double bot_x, bot_y; // in grid cells
+    double heading; // degrees, counter clockwise from the grid's x axis
+    double sin_heading, cos_heading;
+    int center_x, center_y; // bot_x, bot_y rounded; the grid spans SIZE / 2 cells either side
+};
+
+/**
+ * Marks every cell within radius cells of an occupied one (non zero) in a
+ * single channel 8 bit image, by one distance transform instead of radius
+ * dilations. dist is the caller's scratch image for the distances, of the
+ * size of img and IPL_DEPTH_32F, so nothing is allocated per call.
+ */
+void inflateMap(IplImage *img, int radius, IplImage *dist);
+
+#endif
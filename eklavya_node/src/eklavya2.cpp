@@ -11,6 +11,7 @@
 #include "Modules/Navigation/navigation.h"
 #include "Modules/Planner/planner.h"
 #include "Modules/SLAM/slam.h"
+#include "Utils/MapBuffer/map_buffer.h"
 
 //#define DIAG
 
@@ -21,14 +22,15 @@ Pose pose; // Shared by IMU, EKF
 LatLong lat_long; // Shared by GPS, EKF
 Odom odom; // Shared by Encoder, EKF
 
-unsigned char lidar_map[MAP_MAX][MAP_MAX]; // Shared by Lidar, Planner
-unsigned char camera_map[MAP_MAX][MAP_MAX]; // by Camera for lane
-unsigned char global_map[MAP_MAX][MAP_MAX]; // merged without dilate
+MapBuffer lidar_map_buffer; // Shared by Lidar, Fusion
+MapBuffer camera_map_buffer; // by Camera for lane
+MapBuffer global_map_buffer; // merged without dilate
 
 
 Triplet bot_location; // Shared by EKF, Planner
 Triplet target_location; // Shared by EKF, Planner
 vector<Triplet> path;
+vector<Obstacle> obstacles; // Shared by Lidar, Planner
 
 int strategy;
 
@@ -36,22 +38,19 @@ int strategy;
 pthread_mutex_t pose_mutex;
 pthread_mutex_t lat_long_mutex;
 pthread_mutex_t odom_mutex;
-pthread_mutex_t lidar_map_mutex;
 pthread_mutex_t bot_location_mutex;
 pthread_mutex_t target_location_mutex;
 pthread_mutex_t path_mutex;
-pthread_mutex_t camera_map_mutex;
-pthread_mutex_t global_map_mutex;
+pthread_mutex_t obstacles_mutex;
 
 void createMutex() {
     pthread_mutex_init(&pose_mutex, NULL);
     pthread_mutex_init(&lat_long_mutex, NULL);
     pthread_mutex_init(&odom_mutex, NULL);
-    pthread_mutex_init(&lidar_map_mutex, NULL);
     pthread_mutex_init(&bot_location_mutex, NULL);
     pthread_mutex_init(&target_location_mutex, NULL);
     pthread_mutex_init(&path_mutex, NULL);
-    pthread_mutex_init(&camera_map_mutex, NULL);
+    pthread_mutex_init(&obstacles_mutex, NULL);
 
     pthread_mutex_trylock(&pose_mutex);
     pthread_mutex_unlock(&pose_mutex);
@@ -62,12 +61,6 @@ void createMutex() {
     pthread_mutex_trylock(&odom_mutex);
     pthread_mutex_unlock(&odom_mutex);
 
-    pthread_mutex_trylock(&lidar_map_mutex);
-    pthread_mutex_unlock(&lidar_map_mutex);
-
-    pthread_mutex_trylock(&global_map_mutex);
-    pthread_mutex_unlock(&global_map_mutex);
-
     pthread_mutex_trylock(&bot_location_mutex);
     pthread_mutex_unlock(&bot_location_mutex);
 
@@ -77,8 +70,8 @@ void createMutex() {
     pthread_mutex_trylock(&path_mutex);
     pthread_mutex_unlock(&path_mutex);
 
-    pthread_mutex_trylock(&camera_map_mutex);
-    pthread_mutex_unlock(&camera_map_mutex);
+    pthread_mutex_trylock(&obstacles_mutex);
+    pthread_mutex_unlock(&obstacles_mutex);
 }
 
 void startThread(pthread_t *thread_id, pthread_attr_t *thread_attr, void *(*thread_name) (void *)) {
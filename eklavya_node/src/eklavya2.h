@@ -53,16 +53,27 @@ typedef struct Odom {
     double right_velocity;
 } Odom;
 
+typedef struct Obstacle { // lidar blob tracked across scans
+    int id; // of the track, stable across scans
+    double x, y; // centroid, map cells
+    double vx, vy; // cells per second over the ground, along the map axes
+    double radius; // of the blob dilated like the lidar map, cells
+    double stamp; // wall time of the scan, seconds; x, y are in the bot frame at that time
+} Obstacle;
+
+class MapBuffer; // Utils/MapBuffer/map_buffer.h
+
 /* Global data structures to be shared by all threads */
 extern Pose pose; // Shared by IMU, EKF
 extern LatLong lat_long; // Shared by GPS, EKF
 extern Odom odom; // Shared by Encoder, EKF
-extern unsigned char lidar_map[MAP_MAX][MAP_MAX];
-extern unsigned char camera_map[MAP_MAX][MAP_MAX]; // Used by Camera
-extern unsigned char global_map[MAP_MAX][MAP_MAX];
+extern MapBuffer lidar_map_buffer; // Published by Lidar, read by Fusion
+extern MapBuffer camera_map_buffer; // Published by Camera for lane, read by Fusion
+extern MapBuffer global_map_buffer; // Published by Fusion, read by Planner, Diagnostics
 extern Triplet bot_location; // Shared by EKF, Planner
 extern Triplet target_location; // Shared by EKF, Planner
 extern std::vector<Triplet> path;
+extern std::vector<Obstacle> obstacles; // Tracked by Lidar, read by Planner
 
 extern int strategy;
 
@@ -70,12 +81,10 @@ extern int strategy;
 extern pthread_mutex_t pose_mutex;
 extern pthread_mutex_t lat_long_mutex;
 extern pthread_mutex_t odom_mutex;
-extern pthread_mutex_t lidar_map_mutex;
-extern pthread_mutex_t global_map_mutex;
 extern pthread_mutex_t bot_location_mutex;
 extern pthread_mutex_t target_location_mutex;
 extern pthread_mutex_t path_mutex;
-extern pthread_mutex_t camera_map_mutex;
+extern pthread_mutex_t obstacles_mutex;
 
 void *imu_thread(void *arg);
 void *lidar_thread(void *arg);